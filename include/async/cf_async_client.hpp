@@ -5,14 +5,24 @@
 #include <cstdint>
 #include <string>
 #include <optional>
+#include <span>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <atomic>
 
-#include <aws/s3/S3Client.h>
-#include <aws/core/Aws.h>
-#include <aws/core/auth/AWSCredentials.h>
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/thread_pool.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <nlohmann/json.hpp>
 
+#include "async/object_store.hpp"
+#include "async/http_pool.hpp"
+#include "async/object_cache.hpp"
+#include "async/disk_cache.hpp"
+#include "async/request_scheduler.hpp"
+#include "config/config.hpp"
+
 namespace asio = boost::asio;
 
 class CFAsyncClient {
@@ -23,15 +33,11 @@ public:
         std::string key;
         bool headOnly = false;
         bool useCache = false;
+        uint64_t rangeOffset = 0;
+        uint64_t rangeLength = 0; // > 0 for a ranged GET of [rangeOffset, rangeOffset + rangeLength)
     };
 
-    struct GetOutcome {
-        bool err = false;
-        Aws::S3::S3Errors errType = Aws::S3::S3Errors::UNKNOWN;
-        std::string errMsg;
-        std::unordered_map<std::string, std::string> metadata;
-        std::vector<uint8_t> body;
-    };
+    using GetOutcome = ObjectStore::GetOutcome;
 
     struct PutParams {
         std::string bucket;
@@ -41,44 +47,160 @@ public:
         bool useCache = false;
     };
 
-    struct PutOutcome {
+    using PutOutcome = ObjectStore::PutOutcome;
+
+    struct PurgeOutcome {
         bool err = false;
-        Aws::S3::S3Errors errType = Aws::S3::S3Errors::UNKNOWN;
+        bool throttled = false; // 429, back off before the next batch
+        std::chrono::milliseconds retryAfter{0}; // from Retry-After, 0 if absent
         std::string errMsg;
     };
 
+    struct R2Stats {
+        uint64_t requests = 0;
+        uint64_t attempts = 0;
+        uint64_t retries = 0;
+        uint64_t hedges = 0;
+        uint64_t hedgeWins = 0; // hedged attempt finished first
+        uint64_t deadlines = 0;
+        uint64_t errors = 0; // failed after retries
+        double hedgeDelayMs = 0;
+    };
+
     CFAsyncClient(
-        const std::string& r2EndPoint,
-        const std::string& r2AccessKey,
-        const std::string& r2SecretKey,
+        std::unique_ptr<ObjectStore> store,
         const std::string& cfApiToken,
         size_t concurrency,
         bool cacheEnabled = false,
-        size_t cacheCapacity = 0
+        const std::unordered_map<std::string, size_t>& cacheBudgets = {}, // bucket -> bytes, other buckets aren't cached
+        const std::string& cfApiEndPoint = "https://api.cloudflare.com" // empty to skip purges, e.g. on a local store
     );
     ~CFAsyncClient();
     
-    asio::awaitable<GetOutcome> getR2Object(const std::string& bucket, const std::string& key, const bool useCache = false);
-    asio::awaitable<GetOutcome> headR2Object(const std::string& bucket, const std::string& key);
+    asio::awaitable<GetOutcome> getR2Object(
+        const std::string& bucket, 
+        const std::string& key, 
+        const bool useCache = false, 
+        const RequestContext& ctx = {}
+    );
+    // bytes [offset, offset + length), clamped to the object size. served from the memory cache
+    // when the object is there, ranges themselves are never cached
+    asio::awaitable<GetOutcome> getR2ObjectRange(
+        const std::string& bucket,
+        const std::string& key,
+        uint64_t offset,
+        uint64_t length,
+        const bool useCache = false,
+        const RequestContext& ctx = {}
+    );
+    asio::awaitable<GetOutcome> headR2Object(const std::string& bucket, const std::string& key, const RequestContext& ctx = {});
     asio::awaitable<PutOutcome> putR2Object(
         const std::string& bucket, 
         const std::string& key,
         const std::string& contentType,
         std::vector<uint8_t>&& data,
-        const bool useCache = false
+        const bool useCache = false,
+        const RequestContext& ctx = {},
+        const bool writeBack = false // with R2_WRITE_BACK, only update the cache and flush later
     );
-    asio::awaitable<std::vector<GetOutcome>> getManyR2Objects(std::vector<GetParams>&& requests);
-    asio::awaitable<std::vector<PutOutcome>> putManyR2Objects(std::vector<PutParams>&& requests);
-    asio::awaitable<void> purgeCache(const std::vector<std::string>&& urls);
+    asio::awaitable<std::vector<GetOutcome>> getManyR2Objects(std::vector<GetParams>&& requests, const RequestContext& ctx = {});
+    asio::awaitable<std::vector<PutOutcome>> putManyR2Objects(std::vector<PutParams>&& requests, const RequestContext& ctx = {});
+    // one purge_cache call, batching, pacing and retries live in PurgeEngine
+    asio::awaitable<PurgeOutcome> purgeCache(const std::vector<std::string>& urls);
+
+    // keeps an object in the memory cache while the returned pin is alive
+    ObjectCache::Pin pinR2Object(const std::string& bucket, const std::string& key);
+
+    struct CacheStats {
+        std::string bucket;
+        std::string layer;
+        ObjectCache::Counters counters;
+    };
+    std::vector<CacheStats> cacheStats() const;
+    R2Stats r2Stats() const;
+    RequestScheduler::Stats schedulerStats() const;
+
+    struct WriteBackStats {
+        size_t dirty;
+        size_t dirtyBytes;
+        uint64_t writes;
+        uint64_t coalesced; // writes that replaced a not yet flushed version
+        uint64_t flushes;
+        uint64_t flushErrors;
+    };
+    WriteBackStats writeBackStats() const;
+
+    // flushes dirty write-back objects once they are R2_WRITE_BACK_WINDOW_MS old or the dirty
+    // set grows past R2_WRITE_BACK_MAX_DIRTY. runs until flushWriteBack
+    asio::awaitable<void> writeBackLoop();
+    // flush everything now, for shutdown
+    asio::awaitable<void> flushWriteBack();
+    // called after an object is flushed, e.g. to purge it from the cdn
+    void setFlushHook(std::function<void(const std::string& bucket, const std::string& key)> hook);
+
+    // opens R2_PREWARM_CONNECTIONS connections at startup and keeps them ready through quiet
+    // periods by pinging bucket. runs until stop is set
+    asio::awaitable<void> keepWarm(const std::string& bucket, const std::atomic<bool>& stop);
+    // only tracked by stores that manage their own connections
+    HttpPool::Stats connectionStats() const;
 
 private:
-    std::shared_ptr<Aws::S3::S3Client> _s3Cli;
-    asio::thread_pool _threadPool;
+    std::unique_ptr<ObjectStore> _store;
+    asio::thread_pool _threadPool; // disk cache io
     std::string _cfApiToken;
+    std::unique_ptr<HttpPool> _cfApi; // null when purges are disabled
 
     bool _cacheEnabled;
-    size_t _cacheCapacity, _cacheSize;
-    std::list<std::string> _cacheEvictQueue;
-    std::unordered_map<std::string, std::pair<std::list<std::string>::iterator, GetOutcome>> _cache;
+    std::unordered_map<std::string, std::unique_ptr<ObjectCache>> _caches; // per bucket, fixed after construction
+    std::unique_ptr<DiskCache> _diskCache; // second tier under _caches, survives restarts
+
+    // in-flight GETs keyed by bucket+key. only touched from the executor calling getR2Object
+    struct InFlight {
+        asio::steady_timer done; // cancelled once result is set
+        std::optional<GetOutcome> result;
+
+        explicit InFlight(const asio::any_io_executor& exec) : done(exec, asio::steady_timer::time_point::max()) {}
+    };
+    std::unordered_map<std::string, std::shared_ptr<InFlight>> _inFlight;
+
+    RequestScheduler _scheduler;
+
+    // request counters and latency window, only touched from the executor calling in
+    R2Stats _r2Stats;
+    std::vector<double> _latencies = std::vector<double>(CONFIG::R2_LATENCY_WINDOW, 0.0);
+    size_t _latencyPos = 0;
+    double _hedgeDelayMs = 0; // 0 until enough samples
+    std::mt19937 _rng{std::random_device{}()};
+
+    void recordLatency(double ms);
+
+    // write-back, only touched from the executor calling in
+    struct DirtyEntry {
+        std::string bucket;
+        std::string key;
+        std::string contentType;
+        std::shared_ptr<const CachedObject> obj; // the authoritative copy until flushed
+        std::chrono::steady_clock::time_point since;
+        bool flushing = false;
+        ObjectCache::Pin pin; // dirty entries must stay cached
+    };
+    std::unordered_map<std::string, DirtyEntry> _dirty; // by bucket+key
+    size_t _dirtyBytes = 0;
+    bool _writeBackStopping = false;
+    WriteBackStats _wbStats{};
+    std::function<void(const std::string&, const std::string&)> _flushHook;
+
+    asio::awaitable<void> flushDirty(std::string cacheKey);
+
+    // deadline, jittered exponential retries of retryable errors, and optionally a hedged
+    // duplicate attempt once the first is slower than R2_HEDGE_PERCENTILE of recent GETs
+    // every attempt holds a scheduler slot, backoff waits don't
+    template<typename Outcome, typename Attempt>
+    asio::awaitable<Outcome> withRetries(Attempt attempt, const RequestContext& ctx, bool hedge);
+
+    asio::awaitable<std::shared_ptr<const CachedObject>> diskGet(const std::string& cacheKey);
+    ObjectCache* cacheFor(const std::string& bucket) const;
+    void cachePut(const std::string& bucket, const std::string& key, std::shared_ptr<const CachedObject> obj);
+    void diskPut(const std::string& cacheKey, std::shared_ptr<const CachedObject> obj);
 
 };
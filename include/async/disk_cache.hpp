@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <mutex>
+#include <map>
+#include <unordered_map>
+#include <filesystem>
+
+#include "async/object_cache.hpp"
+
+// Persistent second cache tier under the memory LRU. Objects are appended to fixed-size log
+// segments (<dir>/<seq>.seg); each record carries a version and a crc so the index can be
+// rebuilt by scanning the segments on startup, dropping torn records left by a crash.
+// Eviction drops whole segments, oldest first. Reads and writes are blocking file I/O and
+// belong on the R2 thread pool, all methods are thread-safe. The lock is never held over file
+// I/O, a put only takes it to reserve its space and to publish the record once written.
+class DiskCache {
+
+public:
+    DiskCache(std::filesystem::path dir, size_t capacity, size_t segmentSize);
+    ~DiskCache();
+
+    DiskCache(const DiskCache&) = delete;
+    DiskCache& operator=(const DiskCache&) = delete;
+
+    // versions order concurrent puts of the same key, take one before handing the put off
+    uint64_t nextVersion();
+
+    std::shared_ptr<const CachedObject> get(const std::string& key);
+    void put(const std::string& key, const CachedObject& obj, uint64_t version);
+
+    size_t bytes() const;
+    size_t entries() const;
+
+private:
+    struct Segment {
+        int fd = -1;
+        uint64_t seq = 0;
+        size_t size = 0;
+        std::filesystem::path path;
+        ~Segment();
+    };
+
+    struct Loc {
+        std::shared_ptr<Segment> seg;
+        size_t offset; // record start
+        size_t length; // whole record
+        uint64_t version;
+    };
+
+    std::filesystem::path _dir;
+    size_t _capacity;
+    size_t _segmentSize;
+
+    mutable std::mutex _mtx;
+    uint64_t _version = 0;
+    size_t _size = 0;
+    std::map<uint64_t, std::shared_ptr<Segment>> _segments; // by seq, last is active
+    std::unordered_map<std::string, Loc> _index;
+
+    void load();
+    void scan(const std::shared_ptr<Segment>& seg);
+    std::shared_ptr<Segment> openSegment(uint64_t seq);
+    std::shared_ptr<Segment> nextSegment();
+    void evict();
+
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include <optional>
+#include <functional>
+#include <atomic>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <openssl/ssl.h>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/span_body.hpp>
+#include <boost/beast/http/vector_body.hpp>
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+
+// Keep-alive HTTP/1.1 connection pool for a single origin, driven entirely from the calling
+// coroutine's executor. Bodies are never copied: requests borrow the caller's bytes through
+// span_body and responses are read straight into a vector sized from Content-Length.
+class HttpPool {
+
+public:
+    using Request = http::request<http::span_body<const uint8_t>>;
+    using Response = http::response<http::vector_body<uint8_t>>;
+
+    struct Origin {
+        bool tls = true;
+        std::string host;
+        std::string port;
+    };
+
+    struct Result {
+        bool err = false;
+        std::string errMsg; // transport error, the status code is not checked here
+        Response res;
+    };
+
+    struct Stats {
+        uint64_t connects = 0;   // new connections
+        uint64_t resumed = 0;    // of those, tls handshakes that resumed a session
+        uint64_t failed = 0;     // connects that failed
+        double connectMs = 0;    // total time spent in connect and handshake
+        uint64_t pings = 0;
+        size_t idle = 0;
+        size_t active = 0;
+    };
+
+    static Origin parseOrigin(const std::string& url);
+
+    HttpPool(Origin origin, size_t maxIdle);
+
+    asio::awaitable<Result> send(Request& req, bool headOnly = false);
+
+    // opens connections in the background until n are open or being opened
+    asio::awaitable<void> prewarm(size_t n);
+    // keeps warm connections ready through quiet periods: idle ones are pinged with a cheap
+    // request before the server drops them, and lost ones are reopened. runs until stop is set
+    asio::awaitable<void> keepWarm(size_t warm, std::function<Request()> makePing, const std::atomic<bool>& stop);
+
+    const Origin& origin() const { return _origin; }
+    Stats stats() const;
+
+private:
+    struct Conn {
+        std::unique_ptr<beast::tcp_stream> plain;
+        std::unique_ptr<beast::ssl_stream<beast::tcp_stream>> tls;
+        beast::flat_buffer buf;
+        std::chrono::steady_clock::time_point lastUsed;
+        bool sessionSaved = false;
+
+        beast::tcp_stream& tcp() { return tls ? beast::get_lowest_layer(*tls) : *plain; }
+    };
+
+    Origin _origin;
+    size_t _maxIdle;
+    asio::ssl::context _sslCtx;
+    std::optional<asio::ip::tcp::resolver::results_type> _endpoints;
+    std::deque<std::unique_ptr<Conn>> _idle; // only touched from the io executor, oldest first
+    size_t _active = 0;  // checked out by send
+    size_t _opening = 0; // prewarm connects in progress
+    std::shared_ptr<SSL_SESSION> _session; // last resumable session, offered on new handshakes
+    Stats _stats;
+
+    asio::awaitable<std::unique_ptr<Conn>> connect();
+    void release(std::unique_ptr<Conn> conn);
+    void saveSession(Conn& conn);
+    asio::awaitable<void> warmOne();
+    asio::awaitable<bool> ping(Conn& conn, Request& req);
+
+    template <class Stream>
+    asio::awaitable<void> roundTrip(Stream& stream, Conn& conn, Request& req, Response& res, bool headOnly, bool& written);
+
+};
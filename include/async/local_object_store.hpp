@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <atomic>
+
+#include <boost/asio/thread_pool.hpp>
+
+#include "async/object_store.hpp"
+
+// Objects as files under root/bucket/key with a json sidecar (key.meta) holding content type,
+// etag, last modified and metadata. Latency and bandwidth can be injected to approximate R2,
+// so the pipeline can be benchmarked on one machine without network access.
+class LocalObjectStore : public ObjectStore {
+
+public:
+    LocalObjectStore(
+        const std::string& root,
+        int64_t latencyMs = 0,      // added to every request
+        double bandwidthMBps = 0,   // body transfer rate, 0 for unlimited
+        size_t threads = 4          // file io runs here
+    );
+    ~LocalObjectStore();
+
+    asio::awaitable<GetOutcome> get(const std::string& bucket, const std::string& key, const std::string& ifNoneMatch = "") override;
+    asio::awaitable<GetOutcome> head(const std::string& bucket, const std::string& key) override;
+    asio::awaitable<GetOutcome> getRange(const std::string& bucket, const std::string& key, uint64_t offset, uint64_t length) override;
+    asio::awaitable<PutOutcome> put(
+        const std::string& bucket,
+        const std::string& key,
+        const std::string& contentType,
+        std::shared_ptr<const std::vector<uint8_t>> data
+    ) override;
+
+private:
+    std::filesystem::path _root;
+    int64_t _latencyMs;
+    double _bandwidthMBps;
+    asio::thread_pool _threadPool;
+    std::atomic<uint64_t> _tmpSeq{0}; // unique temp names for concurrent puts of one key
+
+    std::filesystem::path pathFor(const std::string& bucket, const std::string& key) const;
+    // simulated network time for a request moving bytes of body
+    asio::awaitable<void> delay(size_t bytes);
+
+};
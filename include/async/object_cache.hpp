@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+// Immutable cached object. Handed out by shared_ptr so hits never copy the body and an entry
+// evicted while a caller still holds it stays alive until the last reference goes away.
+struct CachedObject {
+    std::vector<uint8_t> body;
+    std::unordered_map<std::string, std::string> metadata;
+    std::string etag; // for conditional revalidation, empty if R2 didn't return one
+    std::string lastModified;
+};
+
+// Lock-striped W-TinyLFU byte cache. Keys are spread over independent shards, each with its
+// own mutex and byte budget (capacity / shard count), so it is safe to use from the io thread
+// and the R2 thread pool at the same time.
+//
+// New entries land in a small LRU window. Entries falling out of the window only make it into
+// the main LRU if a frequency sketch says they are accessed more often than the main entry
+// they would evict, so a burst of one-off large writes can't flush the hot set.
+// Pinned keys are never evicted and always admitted.
+class ObjectCache {
+
+public:
+    struct Counters {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t rejects = 0; // dropped by admission
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+    // unpins on destruction
+    class Pin {
+    public:
+        Pin() = default;
+        Pin(ObjectCache* cache, std::string key);
+        Pin(Pin&& other) noexcept;
+        Pin& operator=(Pin&& other) noexcept;
+        ~Pin();
+
+    private:
+        ObjectCache* _cache = nullptr;
+        std::string _key;
+    };
+
+    ObjectCache(size_t capacity, size_t shardCount);
+
+    std::shared_ptr<const CachedObject> get(const std::string& key);
+    void put(const std::string& key, std::shared_ptr<const CachedObject> obj);
+    void erase(const std::string& key);
+
+    void pin(const std::string& key);
+    void unpin(const std::string& key);
+
+    size_t bytes() const;
+    // keyed by layer label, see layerOf
+    std::map<std::string, Counters> stats() const;
+
+private:
+    // count-min sketch of 4 bit saturating counters, halved periodically so old popularity fades
+    class FrequencySketch {
+    public:
+        FrequencySketch();
+        void increment(uint64_t hash);
+        uint8_t frequency(uint64_t hash) const;
+
+    private:
+        std::vector<uint8_t> _table;
+        size_t _additions = 0;
+        size_t index(uint64_t hash, size_t row) const;
+    };
+
+    struct Entry {
+        std::shared_ptr<const CachedObject> obj;
+        size_t size;
+        bool inWindow;
+        std::list<std::string>::iterator it;
+    };
+
+    struct Shard {
+        mutable std::mutex mtx;
+        size_t windowSize = 0;
+        size_t mainSize = 0;
+        std::list<std::string> window; // front is most recent
+        std::list<std::string> main;
+        std::unordered_map<std::string, Entry> map;
+        std::unordered_map<std::string, uint32_t> pins;
+        FrequencySketch sketch;
+        std::unordered_map<std::string, Counters> counters;
+    };
+
+    size_t _windowCapacity;
+    size_t _mainCapacity;
+    std::vector<Shard> _shards;
+
+    Shard& shardFor(const std::string& key);
+    static size_t entrySize(const std::string& key, const CachedObject& obj);
+    static std::string layerOf(const std::string& key);
+
+    void remove(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+    void admit(Shard& shard, const std::string& key);
+    void drainWindow(Shard& shard);
+    void trimMain(Shard& shard);
+    static std::list<std::string>::reverse_iterator lastUnpinned(Shard& shard);
+
+};
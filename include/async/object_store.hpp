@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <span>
+#include <atomic>
+#include <unordered_map>
+
+#include <aws/s3/S3Errors.h>
+#include <boost/asio/awaitable.hpp>
+
+#include "async/object_cache.hpp"
+#include "async/http_pool.hpp"
+
+namespace asio = boost::asio;
+
+// Storage backend under CFAsyncClient. Every call is a single attempt, retries, hedging,
+// scheduling and caching all stay in the client. Errors use the sdk error types callers
+// already check.
+class ObjectStore {
+
+public:
+    struct GetOutcome {
+        bool err = false;
+        Aws::S3::S3Errors errType = Aws::S3::S3Errors::UNKNOWN;
+        std::string errMsg;
+        bool retryable = false;
+        bool notModified = false; // conditional GET matched, no body was sent
+        std::unordered_map<std::string, std::string> metadata;
+        std::string etag;
+        std::string lastModified;
+        std::shared_ptr<const CachedObject> owner; // keeps body alive, shared with the cache on hits
+        std::span<const uint8_t> body;
+
+        static GetOutcome fromObject(std::shared_ptr<const CachedObject> obj) {
+            GetOutcome out;
+            out.metadata = obj->metadata;
+            out.etag = obj->etag;
+            out.lastModified = obj->lastModified;
+            out.body = obj->body;
+            out.owner = std::move(obj);
+            return out;
+        }
+    };
+
+    struct PutOutcome {
+        bool err = false;
+        Aws::S3::S3Errors errType = Aws::S3::S3Errors::UNKNOWN;
+        std::string errMsg;
+        bool retryable = false;
+        std::string etag;
+    };
+
+    virtual ~ObjectStore() = default;
+
+    // with ifNoneMatch set, an unchanged object comes back as notModified without a body
+    virtual asio::awaitable<GetOutcome> get(
+        const std::string& bucket,
+        const std::string& key,
+        const std::string& ifNoneMatch = ""
+    ) = 0;
+    virtual asio::awaitable<GetOutcome> head(const std::string& bucket, const std::string& key) = 0;
+    // bytes [offset, offset + length) clamped to the object size, offsets past the end are an error
+    virtual asio::awaitable<GetOutcome> getRange(
+        const std::string& bucket,
+        const std::string& key,
+        uint64_t offset,
+        uint64_t length
+    ) = 0;
+    // data is shared with the caller and must not be modified until the returned awaitable completes
+    virtual asio::awaitable<PutOutcome> put(
+        const std::string& bucket,
+        const std::string& key,
+        const std::string& contentType,
+        std::shared_ptr<const std::vector<uint8_t>> data
+    ) = 0;
+
+    // keeps connections open through quiet periods until stop is set
+    virtual asio::awaitable<void> keepWarm(const std::string&, const std::atomic<bool>&) { co_return; }
+    // only tracked by backends that manage their own connections
+    virtual HttpPool::Stats connectionStats() const { return {}; }
+
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <unordered_map>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "async/cf_async_client.hpp"
+#include "utils/unique_queue.hpp"
+
+namespace asio = boost::asio;
+
+// Batches CDN purges and keeps several batches in flight. The number of concurrent batches
+// grows additively on success and halves on a 429, which also pauses sending for the
+// Retry-After period. URLs from failed batches are requeued up to PURGE_MAX_ATTEMPTS times.
+// A URL pushed while it is still queued is coalesced into the queued purge.
+// Not thread-safe, use from the io executor.
+class PurgeEngine {
+
+public:
+    struct Stats {
+        size_t queued;
+        size_t inFlight; // batches
+        double window;   // allowed concurrent batches
+        uint64_t purged;
+        uint64_t failedBatches;
+        uint64_t retried;
+        uint64_t dropped;
+        uint64_t throttled;
+        uint64_t coalesced; // pushes of urls that were already queued
+    };
+
+    PurgeEngine(const asio::any_io_executor& exec, std::shared_ptr<CFAsyncClient> cfCli, std::string urlPrefix);
+
+    void push(const std::string& path);
+    asio::awaitable<void> run();
+    // stop accepting new work and wait for the queue to empty
+    asio::awaitable<void> drain();
+
+    Stats stats() const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    std::shared_ptr<CFAsyncClient> _cfCli;
+    std::string _urlPrefix;
+    asio::steady_timer _wake; // cancelled when there may be something to send
+
+    UniqueQueue _queue; // also the pending set, urls are queued once
+    std::unordered_map<std::string, size_t> _attempts; // failed attempts per url
+    size_t _inFlight = 0;
+    double _window = 1;
+    clock::time_point _pausedUntil;
+    clock::time_point _nextSend;
+    bool _running = false;
+    bool _stopping = false;
+
+    uint64_t _purged = 0;
+    uint64_t _failedBatches = 0;
+    uint64_t _retried = 0;
+    uint64_t _dropped = 0;
+    uint64_t _throttled = 0;
+    uint64_t _coalesced = 0;
+
+    asio::awaitable<void> sendBatch(std::vector<std::string> urls);
+
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <list>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <unordered_map>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+namespace asio = boost::asio;
+
+// Client-wide admission for outgoing requests. At most `limit` requests hold a slot at once.
+// Waiters are queued per priority class, higher classes always go first, and within a class
+// jobs take turns round robin so one job with thousands of requests can't starve the others.
+// Not thread-safe, acquire and release from the executor calling into the client.
+class RequestScheduler {
+
+public:
+    enum class Priority : uint8_t {
+        Critical = 0, // chunk and point cloud reads/writes on a job's critical path
+        Normal = 1,
+        Low = 2       // image uploads
+    };
+    static constexpr size_t PRIORITY_COUNT = 3;
+
+    // releases the slot on destruction
+    class Slot {
+    public:
+        Slot() = default;
+        explicit Slot(RequestScheduler* scheduler) : _scheduler(scheduler) {}
+        Slot(Slot&& other) noexcept : _scheduler(std::exchange(other._scheduler, nullptr)) {}
+        Slot& operator=(Slot&& other) noexcept;
+        ~Slot();
+
+    private:
+        RequestScheduler* _scheduler = nullptr;
+    };
+
+    struct Stats {
+        size_t inFlight;
+        std::array<size_t, PRIORITY_COUNT> queued;
+        std::array<size_t, PRIORITY_COUNT> jobs; // jobs with queued requests
+    };
+
+    explicit RequestScheduler(size_t limit);
+
+    asio::awaitable<Slot> acquire(uint64_t job, Priority priority);
+    Stats stats() const;
+
+private:
+    struct Waiter {
+        asio::steady_timer wake; // cancelled once granted
+        bool granted = false;
+
+        explicit Waiter(const asio::any_io_executor& exec) : wake(exec, asio::steady_timer::time_point::max()) {}
+    };
+
+    struct Class {
+        std::list<uint64_t> turns; // jobs with waiters, front goes next
+        std::unordered_map<uint64_t, std::deque<std::shared_ptr<Waiter>>> jobs;
+        size_t queued = 0;
+    };
+
+    size_t _limit;
+    size_t _inFlight = 0;
+    std::array<Class, PRIORITY_COUNT> _classes;
+
+    void release();
+
+};
+
+// who a request is for, used by the scheduler to queue it fairly
+struct RequestContext {
+    uint64_t job = 0;
+    RequestScheduler::Priority priority = RequestScheduler::Priority::Normal;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+
+#include <boost/asio/awaitable.hpp>
+
+#include "async/http_pool.hpp"
+
+namespace asio = boost::asio;
+
+// Minimal S3 client (GetObject, HeadObject, PutObject) speaking SigV4 signed HTTP directly on
+// asio. Requests run on the calling coroutine's executor, so concurrency is bounded by
+// sockets rather than threads.
+class S3HttpClient {
+
+public:
+    struct Result {
+        bool err = false;          // transport failure, status is meaningless
+        std::string errMsg;
+        unsigned status = 0;
+        std::unordered_map<std::string, std::string> metadata; // x-amz-meta-* without the prefix
+        std::string etag;
+        std::string lastModified;
+        std::vector<uint8_t> body;
+    };
+
+    S3HttpClient(
+        const std::string& endPoint,
+        const std::string& accessKey,
+        const std::string& secretKey,
+        size_t maxIdleConnections
+    );
+
+    // with ifNoneMatch set, an unchanged object comes back as a bodyless 304. range is an http
+    // Range value (bytes=first-last), answered with a 206
+    asio::awaitable<Result> getObject(
+        const std::string& bucket, 
+        const std::string& key, 
+        bool headOnly = false,
+        const std::string& ifNoneMatch = "",
+        const std::string& range = ""
+    );
+    asio::awaitable<Result> putObject(
+        const std::string& bucket, 
+        const std::string& key, 
+        const std::string& contentType,
+        std::span<const uint8_t> data
+    );
+
+    // keeps warm connections open, pinging with a HEAD on bucket
+    asio::awaitable<void> keepWarm(const std::string& bucket, size_t warm, const std::atomic<bool>& stop);
+    HttpPool::Stats connectionStats() const { return _pool.stats(); }
+
+private:
+    HttpPool _pool;
+    std::string _accessKey;
+    std::string _secretKey;
+    std::string _signingDate;
+    std::string _signingKey; // derived key, cached per day
+
+    void sign(HttpPool::Request& req, const std::string& canonicalUri);
+    asio::awaitable<Result> send(HttpPool::Request& req, bool headOnly);
+
+};
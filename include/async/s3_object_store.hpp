@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <atomic>
+
+#include <aws/s3/S3Client.h>
+#include <boost/asio/thread_pool.hpp>
+
+#include "async/object_store.hpp"
+#include "async/s3_http_client.hpp"
+
+// R2 through the aws sdk. The sdk blocks, so calls run on a thread pool sized to its
+// connection limit.
+class S3SdkObjectStore : public ObjectStore {
+
+public:
+    S3SdkObjectStore(
+        const std::string& endPoint,
+        const std::string& accessKey,
+        const std::string& secretKey,
+        size_t concurrency
+    );
+    ~S3SdkObjectStore();
+
+    asio::awaitable<GetOutcome> get(const std::string& bucket, const std::string& key, const std::string& ifNoneMatch = "") override;
+    asio::awaitable<GetOutcome> head(const std::string& bucket, const std::string& key) override;
+    asio::awaitable<GetOutcome> getRange(const std::string& bucket, const std::string& key, uint64_t offset, uint64_t length) override;
+    asio::awaitable<PutOutcome> put(
+        const std::string& bucket,
+        const std::string& key,
+        const std::string& contentType,
+        std::shared_ptr<const std::vector<uint8_t>> data
+    ) override;
+
+    // the sdk keeps its own connection pool, concurrent HEADs open and refresh its connections
+    asio::awaitable<void> keepWarm(const std::string& bucket, const std::atomic<bool>& stop) override;
+
+private:
+    std::shared_ptr<Aws::S3::S3Client> _s3Cli;
+    asio::thread_pool _threadPool;
+    uint64_t _requests = 0; // to tell quiet periods apart, only touched from the calling executor
+
+};
+
+// R2 through S3HttpClient on the calling executor.
+class S3NativeObjectStore : public ObjectStore {
+
+public:
+    S3NativeObjectStore(
+        const std::string& endPoint,
+        const std::string& accessKey,
+        const std::string& secretKey,
+        size_t maxIdleConnections
+    );
+
+    asio::awaitable<GetOutcome> get(const std::string& bucket, const std::string& key, const std::string& ifNoneMatch = "") override;
+    asio::awaitable<GetOutcome> head(const std::string& bucket, const std::string& key) override;
+    asio::awaitable<GetOutcome> getRange(const std::string& bucket, const std::string& key, uint64_t offset, uint64_t length) override;
+    asio::awaitable<PutOutcome> put(
+        const std::string& bucket,
+        const std::string& key,
+        const std::string& contentType,
+        std::shared_ptr<const std::vector<uint8_t>> data
+    ) override;
+
+    asio::awaitable<void> keepWarm(const std::string& bucket, const std::atomic<bool>& stop) override;
+    HttpPool::Stats connectionStats() const override { return _cli.connectionStats(); }
+
+private:
+    S3HttpClient _cli;
+
+};
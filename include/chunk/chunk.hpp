@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstdint>
 #include <utility>
+#include <string>
 
 namespace Chunk {
 
@@ -13,4 +14,8 @@ namespace Chunk {
     uint32_t mapBwd(int, size_t);
     uint32_t plotIdToPosIdx(uint32_t);
 
+    // L1/L0 objects are rewritten by every update below them, with R2_WRITE_BACK they are only
+    // flushed to R2 periodically
+    bool writeBack(const std::string&);
+
 }
\ No newline at end of file
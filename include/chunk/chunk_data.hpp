@@ -1,24 +1,36 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 #include <cstdint>
 #include <string>
 #include <optional>
 
 #include <boost/asio/awaitable.hpp>
+#include <boost/asio/any_io_executor.hpp>
 
 #include "async/cf_async_client.hpp"
+#include "utils/codec.hpp"
+#include "chunk/part_store.hpp"
 
 namespace asio = boost::asio;
 
 class ChunkData {
 
 protected:
-    std::unordered_map<uint64_t, std::vector<uint8_t>> _parts;
+    PartStore _parts; // views into the downloaded body, replaced parts own their storage
     std::vector<uint64_t> _needsUpdate;
     std::string _chunkId;
     uint64_t _idl, _idr;
+    uint64_t _jobId = nextJobId(); // groups this chunk's R2 requests in the scheduler
+    asio::any_io_executor _cpuExec; // (de)compression runs here, the calling executor if unset
+
+    static uint64_t nextJobId();
+    RequestContext requestContext(RequestScheduler::Priority priority) const { return {_jobId, priority}; }
+
+    // object codecs, see utils/codec.hpp. dictionaries are per bucket and layer
+    std::string dictName(const std::string& bucket) const;
+    asio::awaitable<Codec::Decoded> decode(std::span<const uint8_t> body) const;
+    asio::awaitable<std::vector<uint8_t>> encode(std::vector<uint8_t>&& buf, bool compress, const std::string& bucket, uint8_t layout = 0) const;
 
     asio::awaitable<void> downloadParts(const std::shared_ptr<CFAsyncClient> cfCli, bool keepAll = false);
     asio::awaitable<void> uploadParts(const std::shared_ptr<CFAsyncClient> cfCli) const;
@@ -28,6 +40,15 @@ public:
     ChunkData(std::string chunkId, std::vector<std::string> needsUpdate);
     virtual ~ChunkData() = default;
 
+    void setCpuExecutor(asio::any_io_executor exec) { _cpuExec = std::move(exec); }
+
+    // only the given parts of the stored chunk, missing ids are left out. indexed (version 2)
+    // chunks are read by range: the index, then the wanted parts, older ones are read whole
+    asio::awaitable<PartStore> readParts(
+        const std::shared_ptr<CFAsyncClient> cfCli,
+        std::vector<uint64_t> ids
+    ) const;
+
     virtual asio::awaitable<void> prep(const std::shared_ptr<CFAsyncClient> cfCli) = 0;
     virtual void process() = 0;
     virtual asio::awaitable<std::optional<std::string>> update(const std::shared_ptr<CFAsyncClient> cfCli) = 0;
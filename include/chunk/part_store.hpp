@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Chunk parts by id in a flat vector sorted by id. Parts read from a downloaded object are
+// views into its body, which is kept alive by adopting its owner, only parts set afterwards
+// own their storage. A part may also get a new head in front of the rest of its data, so a
+// small edit at its start doesn't copy the rest. Iterates in id order.
+class PartStore {
+
+public:
+    struct Entry {
+        uint64_t id;
+        std::span<const uint8_t> data;
+        std::vector<uint8_t> owned; // backs data for replaced parts, empty for views
+        std::vector<uint8_t> head; // packed in front of data, usually empty
+    };
+
+    PartStore() = default;
+    // entries may point into their own storage
+    PartStore(const PartStore&) = delete;
+    PartStore& operator=(const PartStore&) = delete;
+    PartStore(PartStore&&) = default;
+    PartStore& operator=(PartStore&&) = default;
+
+    // keeps owner alive as long as the store, views may point into it
+    void adopt(std::shared_ptr<const void> owner);
+    // part must point into an adopted owner
+    void view(uint64_t id, std::span<const uint8_t> part);
+    void set(uint64_t id, std::vector<uint8_t>&& part);
+    // puts head in place of an existing part's first n bytes (and any earlier head), the rest
+    // stays where it is. get returns the rest only
+    void setHead(uint64_t id, size_t n, std::vector<uint8_t>&& head);
+    void erase(uint64_t id);
+    // the body views were read from and its chunk format version, lets packing copy unchanged
+    // stretches of it in one go. must be adopted
+    void setBase(std::span<const uint8_t> base, uint8_t version) { _base = base; _baseVersion = version; }
+    std::span<const uint8_t> base() const { return _base; }
+    uint8_t baseVersion() const { return _baseVersion; }
+    // payload layout from the object header, up to the chunk type and 0 for most
+    void setLayout(uint8_t layout) { _layout = layout; }
+    uint8_t layout() const { return _layout; }
+
+    bool contains(uint64_t id) const { return find(id) != nullptr; }
+    // empty if missing, without a head set by setHead
+    std::span<const uint8_t> get(uint64_t id) const;
+    std::span<const uint8_t> head(uint64_t id) const;
+
+    size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+    size_t bytes() const; // sum of part sizes, heads included
+    void clear();
+
+    auto begin() const { return _entries.cbegin(); }
+    auto end() const { return _entries.cend(); }
+
+private:
+    std::vector<Entry> _entries;
+    std::vector<std::shared_ptr<const void>> _owners;
+    std::span<const uint8_t> _base;
+    uint8_t _baseVersion = 0;
+    uint8_t _layout = 0;
+
+    const Entry* find(uint64_t id) const;
+    Entry& slot(uint64_t id); // existing entry or a new one at its sorted position
+
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// Point clouds by id as one structure of arrays: x, y, z and color indices of every entry back
+// to back, with the entries sorted by id holding their range. Adding an entry appends a range,
+// replacing or removing one leaves its old range unused until the arrays are compacted, so
+// nothing is allocated per entry. Iterates in id order.
+class PointCloudStore {
+
+public:
+    struct Entry {
+        uint64_t id;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    void reserve(size_t entries, size_t points);
+    // n points for id after all others, replaces an existing entry. filled through the spans
+    Entry add(uint64_t id, uint32_t n);
+    void remove(uint64_t id);
+    void clear();
+
+    // nullptr if missing
+    const Entry* find(uint64_t id) const;
+    bool contains(uint64_t id) const { return find(id) != nullptr; }
+    size_t size() const { return _entries.size(); }
+    bool empty() const { return _entries.empty(); }
+    size_t points() const { return _points; } // in entries, unused ranges left out
+
+    std::span<float> x(const Entry& e) { return {_x.data() + e.offset, e.count}; }
+    std::span<float> y(const Entry& e) { return {_y.data() + e.offset, e.count}; }
+    std::span<float> z(const Entry& e) { return {_z.data() + e.offset, e.count}; }
+    std::span<uint16_t> colors(const Entry& e) { return {_colors.data() + e.offset, e.count}; }
+    std::span<const float> x(const Entry& e) const { return {_x.data() + e.offset, e.count}; }
+    std::span<const float> y(const Entry& e) const { return {_y.data() + e.offset, e.count}; }
+    std::span<const float> z(const Entry& e) const { return {_z.data() + e.offset, e.count}; }
+    std::span<const uint16_t> colors(const Entry& e) const { return {_colors.data() + e.offset, e.count}; }
+    // axis 0, 1 or 2
+    std::span<float> axis(const Entry& e, size_t j) { return j == 0 ? x(e) : j == 1 ? y(e) : z(e); }
+    std::span<const float> axis(const Entry& e, size_t j) const { return j == 0 ? x(e) : j == 1 ? y(e) : z(e); }
+
+    auto begin() const { return _entries.cbegin(); }
+    auto end() const { return _entries.cend(); }
+
+private:
+    std::vector<Entry> _entries;
+    std::vector<float> _x, _y, _z;
+    std::vector<uint16_t> _colors;
+    size_t _points = 0;
+
+    // moves live ranges together in id order once unused ones outweigh them
+    void compact();
+
+};
@@ -15,10 +15,19 @@
 class DChunk : public virtual ChunkData {
 
 protected:
+    // new part of a plot, or only its new header
+    struct PlotPart {
+        std::vector<uint8_t> data;
+        bool headOnly = false;
+    };
+
     std::vector<std::optional<std::vector<uint8_t>>> _updatedImages;
     std::vector<Plot::UpdateFlags> _updateFlags;
+    std::vector<PlotPart> _plotParts;
+    bool _unchanged = false; // every new part is the stored one, nothing to write
    
     asio::awaitable<void> downloadPlotUpdates(const std::shared_ptr<CFAsyncClient> cfCli);
+    PlotPart makePlotPart(const CFAsyncClient::GetOutcome& obj, const Plot::UpdateFlags& flags, std::span<const uint8_t> stored) const;
     asio::awaitable<void> uploadImages(const std::shared_ptr<CFAsyncClient> cfCli) const;
 
 public:
@@ -1,29 +1,46 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 #include <string>
 #include <cstdint>
+#include <memory>
 
-#include <opencv2/core.hpp>
 #include <boost/asio/awaitable.hpp>
 
 #include "chunk/chunk_data.hpp"
-
-struct PointCloud {
-    cv::Mat points;
-    std::vector<uint16_t> colidxs;
+#include "chunk/point_cloud_store.hpp"
+
+// an entry of a serialized point cloud object, pointers into its payload
+struct SerializedPointCloud {
+    uint64_t id;
+    uint32_t count;
+    const uint8_t* header; // the entry's record in the object header
+    const uint8_t* points;
+    const uint8_t* colors;
 };
 
 class LChunk : public virtual ChunkData {
 
 protected:
-    std::unordered_map<uint64_t, PointCloud> _pointClouds;
+    PointCloudStore _pointClouds; // entries written by this update
+    // entries of the stored object left as they were, their bytes are copied into the next upload
+    std::vector<SerializedPointCloud> _storedPointClouds;
+    std::shared_ptr<const void> _storedPointCloudsOwner;
+
+    bool hasPointClouds() const { return !_pointClouds.empty() || !_storedPointClouds.empty(); }
 
     boost::asio::awaitable<void> downloadPointCloud(const std::shared_ptr<CFAsyncClient> cfCli);
     boost::asio::awaitable<void> uploadPointCloud(const std::shared_ptr<CFAsyncClient> cfCli) const;
 
 public:
+    // compact boxes (layout 1) are quantized to the chunk bounds, min xyz and max xyz as floats
+    // in a part of their own
+    static constexpr uint64_t BOUNDS_PART_ID = UINT64_MAX;
+
+    // boxes of a part as 9 floats each: min xyz, max xyz, rgb. parts read by range need
+    // BOUNDS_PART_ID as well for compact chunks
+    static std::vector<float> decodeBoxes(const PartStore& parts, uint64_t id);
+
     LChunk() = default;
     LChunk(
         std::string chunkId, 
@@ -1,17 +1,67 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 // make env
 namespace CONFIG {
     inline constexpr size_t PIPELINE_LIMIT = 25;
     inline constexpr size_t REDIS_CONNECTIONS = 4;
+    inline constexpr int64_t REDIS_UNHEALTHY_COOLDOWN_MS = 2000;
+    inline constexpr int64_t REDIS_HEALTH_CHECK_MS = 1000; // PING per connection, below the cooldown
+    inline constexpr double REDIS_LATENCY_EWMA_ALPHA = 0.2;
+    inline constexpr size_t REDIS_MAX_REDIRECTS = 5;
     inline constexpr size_t R2_CONNECTIONS = 50;
-    inline constexpr size_t R2_CACHE_SIZE = 32; // MB
+    inline constexpr size_t R2_MAX_IN_FLIGHT = R2_CONNECTIONS; // requests holding a scheduler slot at once
+    inline constexpr size_t R2_CACHE_CHUNKS_SIZE = 160; // MB
+    inline constexpr size_t R2_CACHE_POINT_CLOUDS_SIZE = 96; // MB
+    inline constexpr size_t R2_CACHE_SHARDS = 8; // each bucket budget is split over this many shards
+    inline constexpr bool R2_CACHE_REVALIDATE = false; // conditional GET on every hit, for multi-instance deployments
+    inline constexpr bool R2_NATIVE_CLIENT = false; // asio S3 client instead of the aws sdk on a thread pool, R2_BACKEND env overrides
+    inline constexpr const char* LOCAL_STORE_DIR = "store"; // R2_BACKEND=local, LOCAL_STORE_* env overrides
+    inline constexpr int64_t LOCAL_STORE_LATENCY_MS = 0;
+    inline constexpr double LOCAL_STORE_BANDWIDTH_MBPS = 0; // 0 for unlimited
+    inline constexpr bool R2_WRITE_BACK = false; // defer L1/L0 PUTs, the cached copy is authoritative until flushed
+    inline constexpr int64_t R2_WRITE_BACK_WINDOW_MS = 30000; // coalescing window before a dirty object is flushed
+    inline constexpr size_t R2_WRITE_BACK_MAX_DIRTY = 64; // MB, flush oldest first above this
+    inline constexpr bool COMPRESS_CHUNKS = false; // public through the cdn, enable once the frontend decodes version 1
+    inline constexpr bool COMPRESS_POINT_CLOUDS = true;
+    inline constexpr bool QUANTIZE_POINT_CLOUDS = false; // 16 bit positions (layout 1), lossy, enable once the sampled boxes are checked against it
+    inline constexpr bool COMPACT_BOXES = false; // 15 byte L chunk boxes (layout 1), same frontend caveat as COMPRESS_CHUNKS
+    inline constexpr float COMPACT_BOXES_HEADROOM = 0.25f; // of the range, added where the chunk bounds grow
+    inline constexpr bool PLOT_META_HEADER = false; // binary verified/owner header on plot parts, same frontend caveat
+    inline constexpr bool CHUNK_FORMAT_INDEXED = false; // version 2 chunks, same frontend caveat as COMPRESS_CHUNKS
+    inline constexpr size_t CHUNK_INDEX_PROBE = 4096; // bytes read up front, covers the index of ~250 parts
+    inline constexpr size_t CHUNK_RANGE_MERGE_GAP = 16384; // parts closer than this share one ranged GET
+    inline constexpr int ZSTD_LEVEL = 3;
+    inline constexpr const char* ZSTD_DICT_DIR = "static/zstd"; // optional <bucket>_l<layer>.dict files
+    inline constexpr size_t ZSTD_MAX_DECODED_SIZE = 256; // MB, larger frames are rejected before allocating
+    inline constexpr const char* DISK_CACHE_DIR = "cache";
+    inline constexpr size_t DISK_CACHE_SIZE = 4096; // MB, 0 disables the disk tier
+    inline constexpr size_t DISK_CACHE_SEGMENT_SIZE = 64; // MB, eviction drops a whole segment
+    inline constexpr size_t R2_NATIVE_MAX_IDLE = 256; // idle keep-alive connections kept by the native client
+    inline constexpr int64_t R2_DEADLINE_MS = 15000; // whole request including retries and hedges
+    inline constexpr int64_t R2_ATTEMPT_TIMEOUT_MS = 5000; // sdk connect and request timeouts
+    inline constexpr size_t R2_MAX_RETRIES = 3;
+    inline constexpr int64_t R2_RETRY_BASE_MS = 50;
+    inline constexpr int64_t R2_RETRY_MAX_MS = 2000;
+    inline constexpr double R2_HEDGE_PERCENTILE = 0.95; // hedge GETs slower than this share of recent ones
+    inline constexpr int64_t R2_HEDGE_MIN_MS = 20;
+    inline constexpr size_t R2_LATENCY_WINDOW = 1024;
+    inline constexpr int64_t HTTP_IO_TIMEOUT_SEC = 30;
+    inline constexpr size_t HTTP_MAX_BODY_SIZE = ZSTD_MAX_DECODED_SIZE; // MB, no stored object decodes larger
+    inline constexpr int64_t HTTP_IDLE_TIMEOUT_SEC = 50; // drop idle keep-alive connections before the server does
+    inline constexpr int64_t HTTP_KEEPALIVE_SEC = 20; // ping idle warm connections this often
+    inline constexpr size_t R2_PREWARM_CONNECTIONS = R2_CONNECTIONS; // opened at startup and kept ready through quiet periods
     // inline constexpr int64_t L1_UPDATE_DELAY_SEC = 300; // 10 mins
     // inline constexpr int64_t L0_UPDATE_DELAY_SEC = 3600; //1 hour
     inline constexpr int64_t L1_UPDATE_DELAY_SEC = 10;
     inline constexpr int64_t L0_UPDATE_DELAY_SEC = 20;
+    inline constexpr int64_t STATS_INTERVAL_SEC = 60;
+    inline constexpr size_t PURGE_MAX_IN_FLIGHT = 8; // concurrent purge batches at most, the engine adapts below this
+    inline constexpr int64_t PURGE_MIN_INTERVAL_MS = 100; // between batch starts
+    inline constexpr int64_t PURGE_BACKOFF_MS = 5000; // pause after a 429 without Retry-After
+    inline constexpr size_t PURGE_MAX_ATTEMPTS = 5;
 }
 
 namespace VARS {
@@ -30,6 +80,7 @@ namespace VARS {
 
     inline constexpr auto ORIGIN = "http://localhost:5173";
     inline constexpr auto CF_ZONE_ID = "64097c6d2cf0e0810ca05cdf8d4d1273";
+    inline constexpr auto R2_ENDPOINT = "https://1534f5e1cce37d41a018df4c9716751e.r2.cloudflarestorage.com";
     inline constexpr auto CF_CHUNKS_BUCKET = "chunks-dev";
     inline constexpr auto CF_PLOTS_BUCKET = "plots-dev";
     inline constexpr auto CF_IMAGES_BUCKET = "build-images-dev";
@@ -37,14 +88,14 @@ namespace VARS {
     inline constexpr auto CF_CHUNKS_BUCKET_URL = "https://chunks.trraform.com/";
 
     inline constexpr size_t PURGE_URLS_LIMIT = 99;
-    inline constexpr size_t PURGE_DELAY = 1000; //milli-seconds
 
     inline constexpr auto REDIS_EXPIRE = "1800"; // 30 mins
     inline constexpr auto REDIS_UPDATE_QUEUE_PREFIX = "up:q:0"; // may add multi-level queue later
-    inline constexpr auto REDIS_UPDATE_NEEDS_UPDATE_PREFIX = "up:nu:";
-    inline constexpr auto REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX = "up:nu:f:";
-    inline constexpr auto REDIS_FLAG_METADATA_ONLY = "mo";
-    inline constexpr auto REDIS_FLAG_SET_DEFAULT_JSON = "sdj";
-    inline constexpr auto REDIS_FLAG_SET_DEFAULT_BUILD = "sdb";
-    inline constexpr auto REDIS_FLAG_NO_IMAGE_UPDATE = "niu";
+    // chunk keys are hash tagged, see utils/redis_keys.hpp
+    inline constexpr auto REDIS_UPDATE_NEEDS_UPDATE_PREFIX = "up:nu:"; // up:nu:{chunk}
+    inline constexpr auto REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX = "up:nu:f:"; // up:nu:f:{chunk}, hash: plot id -> flag bitmask
+    inline constexpr uint32_t REDIS_FLAG_METADATA_ONLY = 1u << 0;
+    inline constexpr uint32_t REDIS_FLAG_SET_DEFAULT_JSON = 1u << 1;
+    inline constexpr uint32_t REDIS_FLAG_SET_DEFAULT_BUILD = 1u << 2;
+    inline constexpr uint32_t REDIS_FLAG_NO_IMAGE_UPDATE = 1u << 3;
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <string>
+#include <cstdint>
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/any_io_executor.hpp>
+
+namespace asio = boost::asio;
+
+// Chunk and point cloud objects start with 2 bytes: | version | layout << 4 | codec |. Version 0
+// is the original raw layout (both bytes zero), version 1 compresses everything after the header.
+// The layout nibble versions what the payload itself looks like, it is up to the object type
+// and 0 for everything written before it existed.
+// Version 2 is the indexed chunk layout, left uncompressed so it can be read by range, its
+// readers check for it before decoding (see ChunkData).
+// zstd frames carry their dictionary id, so trained dictionaries (`zstd --train`, stored as
+// <ZSTD_DICT_DIR>/<name>.dict) only have to be present when reading, not recorded per object.
+namespace Codec {
+
+    enum class Type : uint8_t { None = 0, Zstd = 1 };
+
+    inline constexpr size_t HEADER_SIZE = 2;
+    inline constexpr uint8_t VERSION_RAW = 0;
+    inline constexpr uint8_t VERSION_COMPRESSED = 1;
+    inline constexpr uint8_t VERSION_INDEXED = 2;
+
+    inline uint8_t codecByte(Type type, uint8_t layout) { return static_cast<uint8_t>(layout << 4 | static_cast<uint8_t>(type)); }
+    inline uint8_t layoutOf(std::span<const uint8_t> body) { return body.size() < HEADER_SIZE ? 0 : body[1] >> 4; }
+
+    struct Decoded {
+        std::vector<uint8_t> owned;       // decompressed payload, empty for raw objects
+        std::span<const uint8_t> payload; // everything after the header, points into the body for raw objects
+        uint8_t layout = 0;
+    };
+
+    // buf starts with HEADER_SIZE reserved bytes. the rest is compressed with the dictionary
+    // called dict if one is loaded, buf is returned as is (version 0) when that doesn't pay off
+    std::vector<uint8_t> encode(std::vector<uint8_t>&& buf, Type type, const std::string& dict = "", uint8_t layout = 0);
+    // accepts versions 0 and 1, throws on others or corrupt data
+    Decoded decode(std::span<const uint8_t> body);
+
+    // the same on exec, e.g. the cpu pool
+    asio::awaitable<std::vector<uint8_t>> encodeOn(
+        asio::any_io_executor exec,
+        std::vector<uint8_t>&& buf,
+        Type type,
+        const std::string& dict = "",
+        uint8_t layout = 0
+    );
+    asio::awaitable<Decoded> decodeOn(asio::any_io_executor exec, std::span<const uint8_t> body);
+
+}
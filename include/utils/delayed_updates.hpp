@@ -8,12 +8,11 @@
 
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/use_awaitable.hpp>
-#include <boost/redis/connection.hpp>
 
 #include "config/config.hpp"
+#include "utils/redis_pool.hpp"
 
 namespace asio = boost::asio;
-namespace redis = boost::redis;
 
 class DelayedUpdates {
 
@@ -24,8 +23,9 @@ private:
         std::greater<std::pair<int64_t, std::string>>
     > _queue;
     std::unordered_map<std::string, std::unordered_set<std::string>> _queuedItems;
+    std::unordered_set<std::string> _unpushed; // needs update set created, chunk not in the queue yet
 
-    asio::awaitable<void> queueUpdate(redis::connection&, const std::string& chunkId);
+    asio::awaitable<void> queueUpdate(RedisPool&, const std::string& chunkId);
 
 public:
     void track(
@@ -34,7 +34,7 @@ public:
         int64_t delaySeconds
     );
 
-    asio::awaitable<void> refresh(redis::connection& redisConn);
-    asio::awaitable<void> purge(redis::connection& redisConn);
+    asio::awaitable<void> refresh(RedisPool& redisPool);
+    asio::awaitable<void> purge(RedisPool& redisPool);
 
 };
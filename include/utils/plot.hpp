@@ -3,6 +3,7 @@
 #include <vector>
 #include <span>
 #include <cstdint>
+#include <string>
 
 #include <nlohmann/json.hpp>
 
@@ -15,14 +16,45 @@ namespace Plot {
         bool noImageUpdate = false;
     };
 
+    UpdateFlags parseUpdateFlags(std::uint32_t mask);
+
+    // Plot parts in chunks may start with a binary header for the fields the server controls:
+    // | magic | flags | owner len | owner (OWNER_SIZE bytes) |, followed by the plot data as it
+    // was uploaded (| json len | json | build len | build |) with the header's fields stripped
+    // from the json and links of unverified plots hidden. The magic can't be a json length, so
+    // parts without the header read as before.
+    struct Meta {
+        bool verified = false;
+        std::string owner;
+    };
+
+    inline constexpr std::uint32_t META_MAGIC = 0xFF544C50; // "PLT\xff" little endian
+    inline constexpr std::uint8_t META_FLAG_VERIFIED = 1u << 0;
+    inline constexpr size_t OWNER_SIZE = 64;
+    inline constexpr size_t META_HEADER_SIZE = sizeof(std::uint32_t) + 2 + OWNER_SIZE;
+
+    bool hasMetaHeader(std::span<const std::uint8_t>);
+    bool fitsMetaHeader(const Meta&);
+    Meta getMeta(std::span<const std::uint8_t>);
+    // rewrites the header of a part that has one in place
+    void setMeta(std::span<std::uint8_t>, const Meta&);
+    // the plot data after the header, all of it for parts without one
+    std::span<const std::uint8_t> stripMetaHeader(std::span<const std::uint8_t>);
+
     nlohmann::json getDefaultJsonPart();
     std::span<const std::uint8_t> getDefaultBuildData();
 
-    std::span<const std::uint8_t> getBuildData(const std::vector<uint8_t>&);
-    nlohmann::json getJsonPart(const std::vector<std::uint8_t>&);
-    std::vector<std::uint16_t> getBuildPart(const std::vector<std::uint8_t>&);
-    std::uint16_t getBuildSize(const std::vector<std::uint8_t>&);
+    std::span<const std::uint8_t> getBuildData(std::span<const std::uint8_t>);
+    std::span<const std::uint8_t> getJsonData(std::span<const std::uint8_t>);
+    // with the header applied
+    nlohmann::json getJsonPart(std::span<const std::uint8_t>);
+    std::vector<std::uint16_t> getBuildPart(std::span<const std::uint8_t>);
+    std::uint16_t getBuildSize(std::span<const std::uint8_t>);
 
     std::vector<std::uint8_t> makePlotData(const nlohmann::json&, const std::span<const std::uint8_t>&);
+    // header, then the json and build data as they are. meta must fit the header
+    std::vector<std::uint8_t> makePlotPart(const Meta&, std::span<const std::uint8_t> jsonData, std::span<const std::uint8_t> buildData);
+    // just the header, meta must fit it
+    std::vector<std::uint8_t> makeMetaHeader(const Meta&);
 
 }
\ No newline at end of file
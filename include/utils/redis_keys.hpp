@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "config/config.hpp"
+
+// Update keys for a chunk share the {chunkId} hash tag so the needs update set and the
+// children's flag hash always land in the same cluster slot (required by the claim scripts)
+namespace RedisKeys {
+
+    inline std::string needsUpdate(const std::string& chunkId) {
+        return VARS::REDIS_UPDATE_NEEDS_UPDATE_PREFIX + ("{" + chunkId + "}");
+    }
+
+    inline std::string updateFlags(const std::string& chunkId) {
+        return VARS::REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX + ("{" + chunkId + "}");
+    }
+
+}
@@ -2,22 +2,185 @@
 
 #include <vector>
 #include <memory>
-#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <tuple>
+#include <type_traits>
 #include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/system/system_error.hpp>
 #include <boost/redis/config.hpp>
 #include <boost/redis/connection.hpp>
+#include <boost/redis/request.hpp>
+#include <boost/redis/response.hpp>
+
+#include "config/config.hpp"
 
 namespace asio = boost::asio;
 namespace redis = boost::redis;
 
+// Routes requests by key. In standalone mode every key maps to the seed node, in cluster mode
+// a slot map (CLUSTER SLOTS) picks the owning node and MOVED/ASK replies are followed.
 class RedisPool {
+public:
+    static constexpr size_t SLOT_COUNT = 16384;
+
+    struct ConnStats {
+        std::string node;
+        size_t outstanding;
+        bool healthy;
+        double latencyMs; // ewma of completed requests
+        uint64_t requests;
+        uint64_t errors;
+    };
+
+    struct Redirect {
+        bool ask;
+        uint16_t slot;
+        std::string host;
+        std::string port;
+    };
+
 private:
-    std::vector<std::unique_ptr<redis::connection>> _connections;
-    size_t _next{0};  // <-- Just plain size_t, no atomic
+    struct Conn {
+        std::unique_ptr<redis::connection> conn;
+        size_t outstanding = 0;
+        bool healthy = true;
+        std::chrono::steady_clock::time_point unhealthyUntil;
+        double latencyMs = 0.0;
+        uint64_t requests = 0;
+        uint64_t errors = 0;
+    };
+
+    struct Node {
+        std::string host, port;
+        std::vector<Conn> conns;
+        std::unique_ptr<redis::connection> blocking; // lazily created, for BRPOP and friends
+    };
+
+    // only touched from the io executor, so no atomics needed
+    asio::any_io_executor _exec;
+    redis::config _cfg;
+    size_t _poolSize;
+    bool _cluster;
+    bool _refreshing = false;
+    std::vector<std::unique_ptr<Node>> _nodes;
+    std::vector<uint16_t> _slots; // slot -> index into _nodes
+
+    Node& nodeFor(std::string_view key);
+    Node& nodeAt(const std::string& host, const std::string& port);
+    size_t pick(Node& node);
+    void complete(Conn& c, std::chrono::steady_clock::time_point start, bool ok, bool connectionError);
+    void markUnhealthy(Conn& c);
+    asio::awaitable<void> watch(Conn& c);
+    void follow(const Redirect& redirect, Node*& node);
+
+    static std::optional<Redirect> parseRedirect(std::string_view diagnostic);
+    static bool isConnectionError(const boost::system::error_code& ec);
+
+    template <class T>
+    static std::optional<Redirect> findRedirect(const redis::adapter::result<T>& r) {
+        return r.has_error() ? parseRedirect(r.error().diagnostic) : std::nullopt;
+    }
+
+    template <class... Ts>
+    static std::optional<Redirect> findRedirect(const std::tuple<Ts...>& res) {
+        std::optional<Redirect> out;
+        std::apply([&out](const auto&... r) { ((out = out ? out : findRedirect(r)), ...); }, res);
+        return out;
+    }
+
+    // ignore_t turns error replies into exec errors and drops the diagnostic, requests that can
+    // be redirected need a typed response
+    template <class Response>
+    static std::optional<Redirect> findRedirect(const Response&) { return std::nullopt; }
+
+    static const redis::request& askingRequest();
+
+    asio::awaitable<void> execOn(redis::connection& conn, bool asking, const redis::request& req, auto& res) {
+        // ASKING only applies to the next command on the connection. both execs are initiated
+        // back to back without yielding, so they are queued adjacently on the connection
+        if (asking)
+            conn.async_exec(askingRequest(), redis::ignore, asio::detached);
+        co_await conn.async_exec(req, res, asio::use_awaitable);
+    }
 
 public:
-    RedisPool(const asio::any_io_executor& exec, const redis::config& cfg, size_t poolSize);
-    
-    redis::connection& get();
-    redis::connection& operator[](size_t idx);
-};
\ No newline at end of file
+    RedisPool(const asio::any_io_executor& exec, const redis::config& cfg, size_t poolSize, bool cluster = false);
+
+    static uint16_t keySlot(std::string_view key);
+
+    // reload the slot map from the cluster (no-op in standalone mode)
+    asio::awaitable<void> refreshSlots();
+
+    // dispatch to the least-loaded healthy connection of the node owning key, tracking
+    // outstanding requests and latency. all keys touched by req must hash to the same slot
+    template <class Response>
+    asio::awaitable<void> exec(std::string_view key, const redis::request& req, Response& res) {
+        Node* node = &nodeFor(key);
+        bool asking = false;
+
+        for (size_t attempt = 0;; ++attempt) {
+            auto& c = node->conns[pick(*node)];
+            ++c.outstanding;
+            const auto start = std::chrono::steady_clock::now();
+
+            // error replies say nothing about the connection, only transport errors mark it
+            try {
+                co_await execOn(*c.conn, asking, req, res);
+            } catch (const boost::system::system_error& e) {
+                complete(c, start, false, isConnectionError(e.code()));
+                throw;
+            } catch (...) {
+                complete(c, start, false, false);
+                throw;
+            }
+            complete(c, start, true, false);
+
+            if (!_cluster || attempt >= CONFIG::REDIS_MAX_REDIRECTS)
+                co_return;
+            const auto redirect = findRedirect(res);
+            if (!redirect)
+                co_return;
+
+            res = Response{};
+            asking = redirect->ask;
+            follow(*redirect, node);
+        }
+    }
+
+    // same routing as exec, but on a dedicated per-node connection for blocking commands
+    template <class Response>
+    asio::awaitable<void> execBlocking(std::string_view key, const redis::request& req, Response& res) {
+        Node* node = &nodeFor(key);
+        bool asking = false;
+
+        for (size_t attempt = 0;; ++attempt) {
+            if (!node->blocking) {
+                auto cfg = _cfg;
+                cfg.addr.host = node->host;
+                cfg.addr.port = node->port;
+                node->blocking = std::make_unique<redis::connection>(_exec, redis::logger(redis::logger::level::emerg));
+                node->blocking->async_run(cfg, asio::detached);
+            }
+            co_await execOn(*node->blocking, asking, req, res);
+
+            if (!_cluster || attempt >= CONFIG::REDIS_MAX_REDIRECTS)
+                co_return;
+            const auto redirect = findRedirect(res);
+            if (!redirect)
+                co_return;
+
+            res = Response{};
+            asking = redirect->ask;
+            follow(*redirect, node);
+        }
+    }
+
+    std::vector<ConnStats> stats() const;
+};
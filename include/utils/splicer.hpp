@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// appends to dst. a splice that continues the previous one in the source extends it, so
+// unchanged stretches of the old body are moved with a single memcpy
+class Splicer {
+
+public:
+    explicit Splicer(uint8_t* dst) : _dst(dst) {}
+
+    // src must stay valid until the next flush
+    void splice(const uint8_t* src, size_t n) {
+        if (_runSrc && _runSrc + _runLen == src) {
+            _runLen += n;
+            return;
+        }
+        flush();
+        _runSrc = src;
+        _runLen = n;
+    }
+
+    void write(const void* src, size_t n) {
+        flush();
+        std::memcpy(_dst, src, n);
+        _dst += n;
+    }
+
+    void flush() {
+        if (_runLen > 0) {
+            std::memcpy(_dst, _runSrc, _runLen);
+            _dst += _runLen;
+        }
+        _runSrc = nullptr;
+        _runLen = 0;
+    }
+
+private:
+    uint8_t* _dst;
+    const uint8_t* _runSrc = nullptr;
+    size_t _runLen = 0;
+
+};
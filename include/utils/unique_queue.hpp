@@ -1,3 +1,5 @@
+#pragma once
+
 #include <queue>
 #include <unordered_set>
 #include <string>
@@ -8,9 +10,12 @@ private:
     std::unordered_set<std::string> _set;
 
 public:
-    void push(const std::string& item) {
-        if (_set.insert(item).second)
-            _queue.push(item);
+    // false if item is already queued
+    bool push(const std::string& item) {
+        if (!_set.insert(item).second)
+            return false;
+        _queue.push(item);
+        return true;
     }
 
     void pop() {
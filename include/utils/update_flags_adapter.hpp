@@ -0,0 +1,14 @@
+#pragma once
+
+#include <boost/system/error_code.hpp>
+#include <boost/redis/resp3/node.hpp>
+
+#include "utils/plot.hpp"
+
+namespace Plot {
+
+    // boost.redis response hook, found through ADL. lets redis::response<std::vector<UpdateFlags>>
+    // parse each integer bitmask reply straight into the flags struct with no intermediate strings
+    void boost_redis_from_bulk(UpdateFlags&, const boost::redis::resp3::node_view&, boost::system::error_code&);
+
+}
@@ -0,0 +1,21 @@
+# Local 3 master redis cluster for testing cluster routing
+# usage: ./cluster.sh start|stop
+# then run trrasvr with REDIS_HOST=127.0.0.1 REDIS_PORT=7000 REDIS_CLUSTER=1 (and REDIS_PASSWORD unset)
+
+PORTS="7000 7001 7002"
+DIR=/tmp/trra-redis-cluster
+
+if [ "$1" = "stop" ]; then
+    for p in $PORTS; do redis-cli -p $p shutdown nosave; done
+    rm -rf $DIR
+    exit 0
+fi
+
+mkdir -p $DIR
+for p in $PORTS; do
+    mkdir -p $DIR/$p
+    redis-server --port $p --cluster-enabled yes --cluster-config-file $DIR/$p/nodes.conf \
+        --dir $DIR/$p --appendonly no --save "" --daemonize yes
+done
+sleep 1
+redis-cli --cluster create 127.0.0.1:7000 127.0.0.1:7001 127.0.0.1:7002 --cluster-replicas 0 --cluster-yes
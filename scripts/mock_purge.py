@@ -0,0 +1,54 @@
+# Local stand-in for the Cloudflare purge_cache endpoint
+# usage: python mock_purge.py [port] [max requests per second]
+# then run trrasvr with CF_API_ENDPOINT=http://127.0.0.1:8787
+# requests over the rate limit get a 429 with Retry-After, like the real api
+
+import sys
+import json
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+PORT = int(sys.argv[1]) if len(sys.argv) > 1 else 8787
+RATE_LIMIT = int(sys.argv[2]) if len(sys.argv) > 2 else 5
+
+window_start = time.time()
+window_count = 0
+purged = 0
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1" # keep-alive
+
+    def reply(self, status, body, headers = {}):
+        data = json.dumps(body).encode()
+        self.send_response(status)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        for k, v in headers.items():
+            self.send_header(k, v)
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        global window_start, window_count, purged
+        length = int(self.headers.get("Content-Length", 0))
+        payload = json.loads(self.rfile.read(length) or b"{}")
+
+        now = time.time()
+        if now - window_start >= 1:
+            window_start, window_count = now, 0
+        window_count += 1
+
+        if window_count > RATE_LIMIT:
+            self.reply(429, {"success": False, "errors": [{"code": 971, "message": "rate limited"}]}, {"Retry-After": "1"})
+            return
+
+        files = payload.get("files", [])
+        purged += len(files)
+        print(f"purged {len(files)} urls ({purged} total)")
+        self.reply(200, {"success": True, "errors": [], "result": {"id": "mock"}})
+
+    def log_message(self, *args):
+        pass
+
+print(f"mock purge api on :{PORT}, {RATE_LIMIT} req/s")
+ThreadingHTTPServer(("127.0.0.1", PORT), Handler).serve_forever()
@@ -0,0 +1,884 @@
+// Round trips of the stored formats through their writers and readers, see roundtrip.sh.
+// Everything runs against scratch directories under the system temp dir, nothing touches R2 or
+// redis. The format switches come from config/config.hpp, roundtrip.sh builds this a second time
+// with all of them on.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/beast/http.hpp>
+#include <fmt/format.h>
+
+#include "async/disk_cache.hpp"
+#include "async/http_pool.hpp"
+#include "async/local_object_store.hpp"
+#include "async/purge_engine.hpp"
+#include "chunk/chunk.hpp"
+#include "chunk/chunk_data.hpp"
+#include "chunk/types/d_chunk.hpp"
+#include "chunk/types/l_chunk.hpp"
+#include "utils/plot.hpp"
+#include "utils/splicer.hpp"
+
+namespace fs = std::filesystem;
+using tcp = asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "[ok] " : "[FAIL] ") << what << std::endl;
+    failures += !ok;
+}
+
+// empty scratch directory for one check
+static fs::path scratch(const std::string& name) {
+    const auto dir = fs::temp_directory_path() / "trrasvr-roundtrip" / name;
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    return dir;
+}
+
+// runs a check's coroutine to completion, exceptions fail the check. whatever it left running
+// (idle connections, mock servers) is stopped with it
+static void runAsync(const std::string& what, std::function<asio::awaitable<void>(asio::io_context&)> fn) {
+    asio::io_context ioc;
+    asio::co_spawn(ioc, fn(ioc), [&](std::exception_ptr e) {
+        ioc.stop();
+        if (!e)
+            return;
+        try {
+            std::rethrow_exception(e);
+        } catch (const std::exception& ex) {
+            check(false, what + ": " + ex.what());
+        }
+    });
+    ioc.run();
+}
+
+static bool sameObject(const std::shared_ptr<const CachedObject>& a, const CachedObject& b) {
+    return a && a->body == b.body && a->metadata == b.metadata && a->etag == b.etag && a->lastModified == b.lastModified;
+}
+
+// records survive a restart, the newest version wins and a torn or corrupt tail is dropped
+static void diskCacheRecord() {
+    const auto dir = scratch("disk-cache");
+    const CachedObject a{{1, 2, 3}, {{"owner", "a"}, {"verified", "true"}}, "\"e1\"", "Tue, 01 Jan 2030 00:00:00 GMT"};
+    const CachedObject b{std::vector<uint8_t>(5000, 7), {}, "", ""};
+    const CachedObject a2{{4, 5}, {{"owner", "b"}}, "\"e2\"", ""};
+    {
+        DiskCache cache(dir, 1 << 20, 1 << 20);
+        const uint64_t va = cache.nextVersion(), vb = cache.nextVersion(), va2 = cache.nextVersion();
+        cache.put("chunks/a", a, va);
+        cache.put("chunks/b", b, vb);
+        cache.put("chunks/a", a2, va2);
+        cache.put("chunks/a", a, va); // older version, ignored
+        check(sameObject(cache.get("chunks/a"), a2) && sameObject(cache.get("chunks/b"), b), "disk cache: get returns the newest put");
+    }
+    {
+        DiskCache cache(dir, 1 << 20, 1 << 20);
+        check(cache.entries() == 2 && sameObject(cache.get("chunks/a"), a2) && sameObject(cache.get("chunks/b"), b), "disk cache: records survive a restart");
+    }
+
+    // a torn record after the last one, as left by a crash mid write
+    const auto first = dir / "0000000000000000.seg";
+    const auto size = fs::file_size(first);
+    std::ofstream(first, std::ios::binary | std::ios::app) << "TRD2 torn";
+    {
+        DiskCache cache(dir, 1 << 20, 1 << 20);
+        check(cache.entries() == 2 && fs::file_size(first) == size && sameObject(cache.get("chunks/a"), a2), "disk cache: a torn tail is truncated");
+    }
+
+    // the last byte is the body of a2, its crc fails and the older version is found again
+    {
+        std::fstream file(first, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(size - 1);
+        file.put(0x55);
+    }
+    {
+        DiskCache cache(dir, 1 << 20, 1 << 20);
+        check(sameObject(cache.get("chunks/a"), a) && sameObject(cache.get("chunks/b"), b), "disk cache: a corrupt record is dropped");
+    }
+
+    // eviction drops whole segments, oldest first
+    {
+        const auto dir = scratch("disk-cache-evict");
+        DiskCache cache(dir, 64 << 10, 16 << 10);
+        const CachedObject obj{std::vector<uint8_t>(4000, 1), {}, "", ""};
+        for (int i = 0; i < 64; ++i)
+            cache.put("k" + std::to_string(i), obj, cache.nextVersion());
+        check(cache.bytes() <= (64 << 10) && !cache.get("k0") && sameObject(cache.get("k63"), obj), "disk cache: oldest segments are evicted");
+    }
+
+    // puts from several threads write outside the lock, every record lands whole and the newest
+    // version of each key is the one found, also after a restart
+    {
+        const auto dir = scratch("disk-cache-threads");
+        std::map<std::string, std::shared_ptr<const CachedObject>> got;
+        bool whole = true;
+        {
+            DiskCache cache(dir, 64 << 20, 1 << 20);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 8; ++t)
+                threads.emplace_back([&cache, t] {
+                    for (int i = 0; i < 50; ++i) {
+                        const CachedObject obj{std::vector<uint8_t>(1000 + 331 * ((t * 50 + i) % 300), static_cast<uint8_t>(t)), {{"t", std::to_string(t)}}, "", ""};
+                        cache.put("k" + std::to_string(i), obj, cache.nextVersion());
+                    }
+                });
+            for (auto& thread : threads)
+                thread.join();
+
+            for (int i = 0; i < 50; ++i) {
+                const auto obj = cache.get("k" + std::to_string(i));
+                whole &= obj && obj->metadata.size() == 1
+                    && std::ranges::all_of(obj->body, [&](uint8_t b) { return std::to_string(b) == obj->metadata.at("t"); });
+                got["k" + std::to_string(i)] = obj;
+            }
+        }
+        DiskCache cache(dir, 64 << 20, 1 << 20);
+        bool same = cache.entries() == got.size();
+        for (const auto& [key, obj] : got)
+            same &= obj && sameObject(cache.get(key), *obj);
+        check(whole && same, "disk cache: concurrent puts land whole and survive a restart");
+    }
+}
+
+// stand-in for the purge_cache endpoint, like scripts/mock_purge.py. the first `throttle`
+// requests get a 429 with Retry-After: 1, the rest succeed
+struct MockPurgeApi {
+    size_t throttle;
+    std::vector<clock_type::time_point> requests;
+    std::vector<clock_type::time_point> throttled; // when the 429s were sent
+};
+
+static asio::awaitable<void> servePurges(tcp::socket socket, MockPurgeApi& api) {
+    beast::flat_buffer buf;
+    for (;;) {
+        http::request<http::string_body> req;
+        boost::system::error_code ec;
+        co_await http::async_read(socket, buf, req, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec)
+            co_return;
+
+        api.requests.push_back(clock_type::now());
+        const bool throttle = api.requests.size() <= api.throttle;
+        http::response<http::string_body> res{throttle ? http::status::too_many_requests : http::status::ok, req.version()};
+        res.set(http::field::content_type, "application/json");
+        if (throttle) {
+            res.set(http::field::retry_after, "1");
+            res.body() = R"({"success":false,"errors":[{"code":971}]})";
+            api.throttled.push_back(clock_type::now());
+        } else
+            res.body() = R"({"success":true,"errors":[]})";
+        res.keep_alive(true);
+        res.prepare_payload();
+        co_await http::async_write(socket, res, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec)
+            co_return;
+    }
+}
+
+static asio::awaitable<void> acceptPurges(tcp::acceptor& acceptor, MockPurgeApi& api) {
+    for (;;) {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+        asio::co_spawn(acceptor.get_executor(), servePurges(std::move(socket), api), asio::detached);
+    }
+}
+
+// a throttled batch pauses sending for Retry-After and its urls are sent again, urls pushed
+// while queued are sent once
+static void purgeEngineBackoff() {
+    MockPurgeApi api{2, {}, {}};
+    runAsync("purge engine", [&](asio::io_context& ioc) -> asio::awaitable<void> {
+        tcp::acceptor acceptor(ioc, {asio::ip::make_address("127.0.0.1"), 0});
+        const auto port = acceptor.local_endpoint().port();
+        asio::co_spawn(ioc, acceptPurges(acceptor, api), asio::detached);
+
+        auto cfCli = std::make_shared<CFAsyncClient>(
+            std::make_unique<LocalObjectStore>(scratch("purge-store")), "token", 4, false,
+            std::unordered_map<std::string, size_t>{}, "http://127.0.0.1:" + std::to_string(port)
+        );
+        PurgeEngine engine(ioc.get_executor(), cfCli, "https://cdn.test/");
+        const size_t urls = VARS::PURGE_URLS_LIMIT + 50;
+        for (size_t i = 0; i < urls; ++i)
+            engine.push("chunks/" + std::to_string(i));
+        // chunks updated again before their batch goes out
+        for (size_t i = 0; i < 100; ++i)
+            engine.push("chunks/" + std::to_string(i));
+
+        asio::co_spawn(ioc, engine.run(), asio::detached);
+        asio::steady_timer timer(ioc);
+        const auto until = clock_type::now() + std::chrono::seconds(10);
+        do {
+            timer.expires_after(std::chrono::milliseconds(50));
+            co_await timer.async_wait(asio::use_awaitable);
+        } while ((engine.stats().queued > 0 || engine.stats().inFlight > 0) && clock_type::now() < until);
+        co_await engine.drain();
+
+        const auto stats = engine.stats();
+        check(stats.purged == urls && stats.dropped == 0 && stats.throttled == 2, "purge engine: throttled batches are sent again");
+        check(stats.retried == 2 * VARS::PURGE_URLS_LIMIT && stats.window >= 1, "purge engine: every url of a throttled batch is requeued");
+        bool paused = api.requests.size() > 2;
+        for (size_t i = 0; i < api.throttled.size() && i + 1 < api.requests.size(); ++i)
+            paused &= api.requests[i + 1] - api.throttled[i] >= std::chrono::milliseconds(950);
+        check(paused, "purge engine: sending pauses for Retry-After");
+        check(stats.coalesced == 100, "purge engine: urls pushed again while queued are purged once");
+    });
+}
+
+// answers with keep-alive but closes the connection after every response, so the next request
+// on it finds it stale
+static asio::awaitable<void> serveOnce(tcp::socket socket, size_t& requests) {
+    beast::flat_buffer buf;
+    http::request<http::string_body> req;
+    boost::system::error_code ec;
+    co_await http::async_read(socket, buf, req, asio::redirect_error(asio::use_awaitable, ec));
+    if (ec)
+        co_return;
+    requests++;
+    http::response<http::string_body> res{http::status::ok, req.version()};
+    res.keep_alive(true);
+    res.prepare_payload();
+    co_await http::async_write(socket, res, asio::redirect_error(asio::use_awaitable, ec));
+}
+
+static asio::awaitable<void> acceptOnce(tcp::acceptor& acceptor, size_t& requests) {
+    for (;;) {
+        auto socket = co_await acceptor.async_accept(asio::use_awaitable);
+        asio::co_spawn(acceptor.get_executor(), serveOnce(std::move(socket), requests), asio::detached);
+    }
+}
+
+static asio::awaitable<HttpPool::Result> sendStale(HttpPool& pool, http::verb method) {
+    // give the close time to arrive
+    asio::steady_timer timer(co_await asio::this_coro::executor, std::chrono::milliseconds(50));
+    co_await timer.async_wait(asio::use_awaitable);
+    HttpPool::Request req{method, "/", 11};
+    co_return co_await pool.send(req);
+}
+
+// a request that fails on a stale keep-alive connection is sent again on a fresh one only if
+// it is idempotent
+static void httpPoolReplay() {
+    size_t requests = 0;
+    runAsync("http pool", [&](asio::io_context& ioc) -> asio::awaitable<void> {
+        tcp::acceptor acceptor(ioc, {asio::ip::make_address("127.0.0.1"), 0});
+        asio::co_spawn(ioc, acceptOnce(acceptor, requests), asio::detached);
+        HttpPool pool({false, "127.0.0.1", std::to_string(acceptor.local_endpoint().port())}, 4);
+
+        const auto first = co_await sendStale(pool, http::verb::get);
+        const auto get = co_await sendStale(pool, http::verb::get);
+        check(!first.err && !get.err && requests == 2, "http pool: a GET on a stale connection is sent again");
+        const auto post = co_await sendStale(pool, http::verb::post);
+        check(post.err && requests == 2, "http pool: a POST on a stale connection is not sent again");
+    });
+}
+
+// parts of a chunk object in and out of a local store
+struct PartsChunk : ChunkData {
+    using ChunkData::ChunkData;
+    asio::awaitable<void> prep(const std::shared_ptr<CFAsyncClient>) override { co_return; }
+    void process() override {}
+    asio::awaitable<std::optional<std::string>> update(const std::shared_ptr<CFAsyncClient>) override { co_return std::nullopt; }
+
+    PartStore& parts() { return _parts; }
+    asio::awaitable<void> download(const std::shared_ptr<CFAsyncClient> cfCli) { co_await downloadParts(cfCli); }
+    asio::awaitable<void> upload(const std::shared_ptr<CFAsyncClient> cfCli) { co_await uploadParts(cfCli); }
+};
+
+using PartMap = std::map<uint64_t, std::vector<uint8_t>>;
+
+static bool sameParts(const PartStore& parts, const PartMap& want) {
+    if (parts.size() != want.size())
+        return false;
+    for (const auto& [id, data] : want) {
+        const auto part = parts.get(id);
+        if (!parts.contains(id) || !std::ranges::equal(part, data))
+            return false;
+    }
+    return true;
+}
+
+static std::vector<uint8_t> randomBytes(std::mt19937& rng, size_t n) {
+    std::vector<uint8_t> out(n);
+    for (auto& b : out)
+        b = rng() % 16; // compressible, so compressed objects are written compressed
+    return out;
+}
+
+// a chunk written in the configured format reads back the same, also after an edit that packs
+// unchanged parts straight from the downloaded body
+static void chunkParts() {
+    runAsync("chunk parts", [](asio::io_context&) -> asio::awaitable<void> {
+        auto cfCli = std::make_shared<CFAsyncClient>(std::make_unique<LocalObjectStore>(scratch("chunk-store")), "", 4);
+        const auto chunkId = Chunk::makeIdStr(2, 0x1a, true);
+        std::mt19937 rng(7);
+        PartMap want;
+        {
+            PartsChunk chunk(chunkId, {});
+            for (const auto& [id, n] : std::vector<std::pair<uint64_t, size_t>>{{0x10, 0}, {0x11, 1}, {0x8694, 300}, {0x8695, 5000}, {0xffff0000, 70000}}) {
+                want[id] = randomBytes(rng, n);
+                chunk.parts().set(id, std::vector<uint8_t>(want[id]));
+            }
+            co_await chunk.upload(cfCli);
+        }
+
+        const auto stored = co_await cfCli->getR2Object(VARS::CF_CHUNKS_BUCKET, chunkId);
+        const uint8_t version = CONFIG::CHUNK_FORMAT_INDEXED ? Codec::VERSION_INDEXED
+            : CONFIG::COMPRESS_CHUNKS ? Codec::VERSION_COMPRESSED : Codec::VERSION_RAW;
+        check(!stored.err && !stored.body.empty() && stored.body[0] == version, fmt::format("chunk parts: written as version {}", version));
+
+        {
+            PartsChunk chunk(chunkId, {});
+            co_await chunk.download(cfCli);
+            check(sameParts(chunk.parts(), want), "chunk parts: read back the same");
+
+            // replace one, drop one, add one, the rest stay views into the body
+            want[0x8694] = randomBytes(rng, 301);
+            want.erase(0x11);
+            want[0x9000] = randomBytes(rng, 20);
+            chunk.parts().set(0x8694, std::vector<uint8_t>(want[0x8694]));
+            chunk.parts().erase(0x11);
+            chunk.parts().set(0x9000, std::vector<uint8_t>(want[0x9000]));
+            co_await chunk.upload(cfCli);
+        }
+        {
+            PartsChunk chunk(chunkId, {});
+            co_await chunk.download(cfCli);
+            check(sameParts(chunk.parts(), want), "chunk parts: an edited chunk reads back the same");
+        }
+        {
+            // only the wanted parts, by range for indexed chunks. missing ids are left out
+            PartsChunk chunk(chunkId, {});
+            std::vector<uint64_t> ids{0xffff0000, 0x10, 0x8694, 0x12345};
+            const auto got = co_await chunk.readParts(cfCli, ids);
+            PartMap some;
+            for (const auto id : ids)
+                if (want.contains(id))
+                    some[id] = want[id];
+            check(sameParts(got, some), "chunk parts: read just the wanted parts");
+        }
+
+        // ranges are clamped to the object, offsets past its end are an error
+        const auto whole = co_await cfCli->getR2Object(VARS::CF_CHUNKS_BUCKET, chunkId);
+        const auto tail = co_await cfCli->getR2ObjectRange(VARS::CF_CHUNKS_BUCKET, chunkId, whole.body.size() - 10, 100);
+        const auto past = co_await cfCli->getR2ObjectRange(VARS::CF_CHUNKS_BUCKET, chunkId, whole.body.size(), 100);
+        check(!tail.err && std::ranges::equal(tail.body, whole.body.last(10)) && past.err, "chunk parts: ranges are clamped to the object");
+
+        // a raw payload cut inside a part header or inside a part is rejected, not read past
+        std::vector<uint8_t> body{Codec::VERSION_RAW, Codec::codecByte(Codec::Type::None, 0)};
+        for (const auto& [id, n] : std::vector<std::pair<uint64_t, uint32_t>>{{0x10, 16}, {0x11, 50}}) {
+            body.insert(body.end(), reinterpret_cast<const uint8_t*>(&id), reinterpret_cast<const uint8_t*>(&id) + sizeof(id));
+            body.insert(body.end(), reinterpret_cast<const uint8_t*>(&n), reinterpret_cast<const uint8_t*>(&n) + sizeof(n));
+            body.resize(body.size() + n, 0x5a);
+        }
+        const std::vector<size_t> cuts{Codec::HEADER_SIZE + 12 + 16 + 5, body.size() - 10};
+        bool rejected = true;
+        for (size_t k = 0; k < cuts.size(); ++k) {
+            const auto cutId = Chunk::makeIdStr(2, 0x1b + k, true);
+            co_await cfCli->putR2Object(VARS::CF_CHUNKS_BUCKET, cutId, "application/octet-stream", std::vector<uint8_t>(body.begin(), body.begin() + cuts[k]));
+            bool threw = false;
+            try {
+                PartsChunk chunk(cutId, {});
+                co_await chunk.download(cfCli);
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            rejected &= threw;
+        }
+        check(rejected, "chunk parts: truncated payloads are rejected");
+    });
+}
+
+// a D chunk whose plot updates change nothing is found out from the parts they touch, and
+// neither rewrites the chunk nor disturbs its other parts
+struct PlotsChunk : DChunk {
+    // the most derived class initializes the virtual base
+    PlotsChunk(std::string chunkId, std::vector<std::string> needsUpdate, std::vector<Plot::UpdateFlags> updateFlags)
+        : ChunkData(std::move(chunkId), std::move(needsUpdate)), DChunk(std::move(updateFlags)) {}
+    bool unchanged() const { return _unchanged; }
+};
+
+// the dev plots bucket key every update reads (see DChunk::downloadPlotUpdates)
+static const std::string PLOT_KEY = "8694";
+
+static void setPlotMeta(const fs::path& root, const Plot::Meta& meta) {
+    const auto path = root / VARS::CF_PLOTS_BUCKET / (PLOT_KEY + ".meta");
+    auto json = nlohmann::json::parse(std::ifstream(path));
+    json["metadata"] = {{"verified", meta.verified ? "true" : "false"}, {"owner", meta.owner}};
+    std::ofstream(path) << json.dump();
+}
+
+static asio::awaitable<bool> updatePlot(std::shared_ptr<CFAsyncClient> cfCli, std::string chunkId, Plot::UpdateFlags flags) {
+    PlotsChunk chunk(std::move(chunkId), std::vector<std::string>{PLOT_KEY}, std::vector<Plot::UpdateFlags>{flags});
+    co_await chunk.prep(cfCli);
+    chunk.process();
+    co_await chunk.update(cfCli);
+    co_return chunk.unchanged();
+}
+
+static void plotUpdates() {
+    runAsync("plot updates", [](asio::io_context&) -> asio::awaitable<void> {
+        const auto root = scratch("plot-store");
+        auto cfCli = std::make_shared<CFAsyncClient>(std::make_unique<LocalObjectStore>(root), "", 4);
+        const auto chunkId = Chunk::makeIdStr(2, 0x1d, true);
+        const auto chunkPath = root / VARS::CF_CHUNKS_BUCKET / chunkId;
+        const uint64_t plotId = std::stoull(PLOT_KEY, nullptr, 16);
+        std::mt19937 rng(11);
+
+        // a large neighbour, so the plot part is past the first ranged read
+        const auto neighbour = randomBytes(rng, 70000);
+        {
+            PartsChunk chunk(chunkId, {});
+            chunk.parts().set(0x10, std::vector<uint8_t>(neighbour));
+            co_await chunk.upload(cfCli);
+        }
+
+        nlohmann::json json = Plot::getDefaultJsonPart();
+        co_await cfCli->putR2Object(VARS::CF_PLOTS_BUCKET, PLOT_KEY, "application/octet-stream", Plot::makePlotData(json, Plot::getDefaultBuildData()));
+        setPlotMeta(root, {true, "alice"});
+
+        const Plot::UpdateFlags full{};
+        Plot::UpdateFlags metadataOnly{};
+        metadataOnly.metadataOnly = true;
+
+        const bool first = co_await updatePlot(cfCli, chunkId, full);
+        const auto written = fs::last_write_time(chunkPath);
+        const bool again = co_await updatePlot(cfCli, chunkId, full);
+        check(!first && again && fs::last_write_time(chunkPath) == written, "plot updates: a repeated update doesn't rewrite the chunk");
+
+        setPlotMeta(root, {true, "bob"});
+        const bool renamed = co_await updatePlot(cfCli, chunkId, metadataOnly);
+        const auto renamedAt = fs::last_write_time(chunkPath);
+        const bool renamedAgain = co_await updatePlot(cfCli, chunkId, metadataOnly);
+        check(!renamed && renamedAgain && fs::last_write_time(chunkPath) == renamedAt, "plot updates: a repeated metadata update doesn't rewrite the chunk");
+
+        PartsChunk chunk(chunkId, {});
+        co_await chunk.download(cfCli);
+        const auto part = chunk.parts().get(plotId);
+        check(
+            chunk.parts().size() == 2 && std::ranges::equal(chunk.parts().get(0x10), neighbour)
+                && Plot::getJsonPart(part).value("owner", "") == "bob" && std::ranges::equal(Plot::getBuildData(part), Plot::getDefaultBuildData()),
+            "plot updates: the plot part is updated and its neighbour kept"
+        );
+    });
+}
+
+// plot parts with the metadata header read back their fields, and a header put over a stored
+// part with setHead replaces just those bytes of it
+static void plotMetaHeader() {
+    nlohmann::json json = Plot::getDefaultJsonPart();
+    json["link"] = "https://example.com";
+    const std::string jsonStr = json.dump();
+    const std::span<const uint8_t> jsonData(reinterpret_cast<const uint8_t*>(jsonStr.data()), jsonStr.size());
+    std::mt19937 rng(11);
+    const auto buildData = randomBytes(rng, 64);
+
+    const Plot::Meta meta{false, "owner"};
+    const auto part = Plot::makePlotPart(meta, jsonData, buildData);
+    const auto header = Plot::makeMetaHeader(meta);
+    const auto read = Plot::hasMetaHeader(part) ? Plot::getMeta(part) : Plot::Meta{};
+    const auto parsed = Plot::getJsonPart(part);
+    check(read.verified == meta.verified && read.owner == meta.owner
+        && std::ranges::equal(header, std::span(part).first(Plot::META_HEADER_SIZE))
+        && std::ranges::equal(Plot::getJsonData(part), jsonData)
+        && std::ranges::equal(Plot::getBuildData(part), buildData), "plot meta header: a part reads back its header, json and build");
+    check(parsed["owner"] == meta.owner && parsed["verified"] == false && parsed["link"] == "", "plot meta header: the json gets the header fields, links of unverified plots hidden");
+
+    const auto plain = Plot::makePlotData(json, buildData);
+    check(!Plot::hasMetaHeader(plain) && Plot::stripMetaHeader(plain).size() == plain.size()
+        && std::ranges::equal(Plot::getBuildData(plain), buildData), "plot meta header: parts without it read as before");
+    check(!Plot::fitsMetaHeader(Plot::Meta{true, std::string(Plot::OWNER_SIZE + 1, 'x')}), "plot meta header: owners too long for it don't fit");
+
+    runAsync("plot meta header", [](asio::io_context&) -> asio::awaitable<void> {
+        auto cfCli = std::make_shared<CFAsyncClient>(std::make_unique<LocalObjectStore>(scratch("plot-store")), "", 4);
+        const auto chunkId = Chunk::makeIdStr(3, 0x2b, true);
+        std::mt19937 rng(13);
+        const std::string jsonStr = Plot::getDefaultJsonPart().dump();
+        const std::span<const uint8_t> jsonData(reinterpret_cast<const uint8_t*>(jsonStr.data()), jsonStr.size());
+        const auto buildData = randomBytes(rng, 128);
+        const Plot::Meta before{false, "someone"};
+        const Plot::Meta after{true, "someone else"};
+
+        PartMap want;
+        {
+            PartsChunk chunk(chunkId, {});
+            want[0x5] = randomBytes(rng, 40);
+            want[0x7] = Plot::makePlotPart(before, jsonData, buildData);
+            want[0x9] = randomBytes(rng, 40);
+            for (const auto& [id, data] : want)
+                chunk.parts().set(id, std::vector<uint8_t>(data));
+            co_await chunk.upload(cfCli);
+        }
+        {
+            PartsChunk chunk(chunkId, {});
+            co_await chunk.download(cfCli);
+            chunk.parts().setHead(0x7, Plot::META_HEADER_SIZE, Plot::makeMetaHeader(after));
+            check(std::ranges::equal(chunk.parts().get(0x7), Plot::stripMetaHeader(want[0x7])), "plot meta header: get skips a head set over a part");
+            co_await chunk.upload(cfCli);
+        }
+
+        want[0x7] = Plot::makePlotPart(after, jsonData, buildData);
+        PartsChunk chunk(chunkId, {});
+        co_await chunk.download(cfCli);
+        const auto part = chunk.parts().get(0x7);
+        const auto meta = Plot::hasMetaHeader(part) ? Plot::getMeta(part) : Plot::Meta{};
+        check(sameParts(chunk.parts(), want) && meta.verified && meta.owner == after.owner, "plot meta header: a new head is packed in place of the old one");
+    });
+}
+
+// runs of adjacent splices are copied as one, writes and gaps in the source break them
+static void splicer() {
+    std::vector<uint8_t> src(64), dst(64, 0xff), want;
+    for (size_t i = 0; i < src.size(); ++i)
+        src[i] = static_cast<uint8_t>(i);
+    const uint8_t mark[2] = {0xaa, 0xbb};
+
+    Splicer out(dst.data());
+    out.splice(src.data(), 4);
+    out.splice(src.data() + 4, 6); // continues the run
+    out.write(mark, 2);
+    out.splice(src.data() + 20, 3);
+    out.splice(src.data() + 30, 0);
+    out.splice(src.data() + 40, 5); // a gap starts a new run
+    out.flush();
+
+    want.insert(want.end(), src.begin(), src.begin() + 10);
+    want.insert(want.end(), mark, mark + 2);
+    want.insert(want.end(), src.begin() + 20, src.begin() + 23);
+    want.insert(want.end(), src.begin() + 40, src.begin() + 45);
+    check(std::equal(want.begin(), want.end(), dst.begin()) && dst[want.size()] == 0xff, "splicer: output matches the spliced ranges");
+}
+
+// point clouds of an L chunk object in and out of a local store
+struct PointCloudChunk : LChunk {
+    PointCloudChunk(std::string chunkId, std::vector<std::string> needsUpdate) : ChunkData(std::move(chunkId), std::move(needsUpdate)) {}
+
+    PointCloudStore& pointClouds() { return _pointClouds; }
+    const PartStore& parts() const { return _parts; }
+    asio::awaitable<void> download(const std::shared_ptr<CFAsyncClient> cfCli) { co_await downloadPointCloud(cfCli); }
+    asio::awaitable<void> upload(const std::shared_ptr<CFAsyncClient> cfCli) { co_await uploadPointCloud(cfCli); }
+    asio::awaitable<void> downloadBoxes(const std::shared_ptr<CFAsyncClient> cfCli) { co_await downloadParts(cfCli); }
+    asio::awaitable<void> uploadBoxes(const std::shared_ptr<CFAsyncClient> cfCli) { co_await uploadParts(cfCli); }
+};
+
+using Point = std::array<float, 4>; // x, y, z, color index
+using PointMap = std::map<uint64_t, std::vector<Point>>;
+
+// a point cloud object read by the layouts documented in l_chunk.cpp, independent of its reader
+static PointMap parsePointClouds(std::span<const uint8_t> body) {
+    const auto decoded = Codec::decode(body);
+    const auto p = decoded.payload;
+    const bool quantized = decoded.layout == 1;
+    const auto read = [&](size_t at, auto& v) { std::memcpy(&v, p.data() + at, sizeof(v)); };
+
+    uint32_t entries, points;
+    read(0, entries);
+    read(4, points);
+    const size_t entrySize = 12 + (quantized ? 24 : 0);
+    size_t head = 8, pnt = 8 + entries * entrySize, col = pnt + points * (quantized ? 6 : 12);
+
+    PointMap out;
+    for (uint32_t i = 0; i < entries; ++i, head += entrySize) {
+        uint64_t id;
+        uint32_t n;
+        float bounds[6];
+        read(head, id);
+        read(head + 8, n);
+        if (quantized)
+            std::memcpy(bounds, p.data() + head + 12, sizeof(bounds));
+
+        auto& pts = out[id];
+        pts.resize(n);
+        uint16_t color = 0;
+        for (uint32_t j = 0; j < n; ++j) {
+            for (size_t a = 0; a < 3; ++a) {
+                if (quantized) {
+                    uint16_t q;
+                    read(pnt + (a * n + j) * 2, q);
+                    pts[j][a] = bounds[a] + q * ((bounds[3 + a] - bounds[a]) / 65535.f);
+                } else
+                    read(pnt + (j * 3 + a) * 4, pts[j][a]);
+            }
+            uint16_t c;
+            read(col + j * 2, c);
+            color = quantized ? color + c : c; // delta coded in layout 1
+            pts[j][3] = color;
+        }
+        pnt += n * (quantized ? 6 : 12);
+        col += n * 2;
+    }
+    return out;
+}
+
+// entries match up to the quantization step of their bounds. colors are distinct within an
+// entry, so points are matched by color, layout 1 reorders them
+static bool samePointClouds(PointMap got, PointMap want) {
+    if (got.size() != want.size())
+        return false;
+    for (auto& [id, pts] : want) {
+        auto& other = got[id];
+        if (other.size() != pts.size())
+            return false;
+        if (pts.empty())
+            continue;
+        std::ranges::sort(pts, {}, [](const Point& p) { return p[3]; });
+        std::ranges::sort(other, {}, [](const Point& p) { return p[3]; });
+        for (size_t a = 0; a < 3; ++a) {
+            const auto [lo, hi] = std::ranges::minmax(pts | std::views::transform([a](const Point& p) { return p[a]; }));
+            const float tolerance = CONFIG::QUANTIZE_POINT_CLOUDS ? (hi - lo) / 65535.f : 0.f;
+            for (size_t j = 0; j < pts.size(); ++j)
+                if (other[j][3] != pts[j][3] || std::abs(other[j][a] - pts[j][a]) > tolerance)
+                    return false;
+        }
+    }
+    return true;
+}
+
+static void addPointCloud(PointCloudStore& store, uint64_t id, const std::vector<Point>& pts) {
+    const auto e = store.add(id, pts.size());
+    for (size_t j = 0; j < pts.size(); ++j) {
+        for (size_t a = 0; a < 3; ++a)
+            store.axis(e, a)[j] = pts[j][a];
+        store.colors(e)[j] = static_cast<uint16_t>(pts[j][3]);
+    }
+}
+
+static std::vector<Point> randomPoints(std::mt19937& rng, size_t n, float scale) {
+    std::vector<Point> pts(n);
+    std::uniform_real_distribution<float> d(-scale, scale);
+    for (size_t j = 0; j < n; ++j)
+        pts[j] = {d(rng), d(rng), d(rng), static_cast<float>((j * 7919) % 65536)};
+    return pts;
+}
+
+// point clouds read back in the configured layout, quantized ones within a step of their bounds,
+// also after patching some entries of a stored object
+static void pointClouds() {
+    runAsync("point clouds", [](asio::io_context&) -> asio::awaitable<void> {
+        auto cfCli = std::make_shared<CFAsyncClient>(std::make_unique<LocalObjectStore>(scratch("point-cloud-store")), "", 4);
+        const auto chunkId = Chunk::makeIdStr(4, 3, true);
+        std::mt19937 rng(11);
+        PointMap want{{1, randomPoints(rng, 1, 10)}, {2, randomPoints(rng, 2, 10)}, {5, {}}, {9, randomPoints(rng, 1000, 500)}};
+        {
+            PointCloudChunk chunk(chunkId, {});
+            for (const auto& [id, pts] : want)
+                addPointCloud(chunk.pointClouds(), id, pts);
+            co_await chunk.upload(cfCli);
+        }
+
+        const auto stored = co_await cfCli->getR2Object(VARS::CF_POINT_CLOUDS_BUCKET, chunkId);
+        check(!stored.err && Codec::layoutOf(stored.body) == (CONFIG::QUANTIZE_POINT_CLOUDS ? 1 : 0), "point clouds: written in the configured layout");
+        check(!stored.err && samePointClouds(parsePointClouds(stored.body), want), "point clouds: read back within the quantization step");
+
+        // entry 2 is replaced and 0xa added, the others are copied from the stored object. the
+        // expected points are what was read back, kept entries are not quantized again
+        want = parsePointClouds(stored.body);
+        want[2] = randomPoints(rng, 3, 10);
+        want[0xa] = randomPoints(rng, 50, 10);
+        {
+            const std::vector<std::string> needsUpdate{"2", "a"};
+            PointCloudChunk chunk(chunkId, needsUpdate);
+            co_await chunk.download(cfCli);
+            addPointCloud(chunk.pointClouds(), 2, want[2]);
+            addPointCloud(chunk.pointClouds(), 0xa, want[0xa]);
+            co_await chunk.upload(cfCli);
+        }
+        const auto patched = co_await cfCli->getR2Object(VARS::CF_POINT_CLOUDS_BUCKET, chunkId);
+        const auto got = parsePointClouds(patched.body);
+        bool keptAsIs = true;
+        for (const uint64_t id : {1, 5, 9})
+            keptAsIs &= got.contains(id) && got.at(id) == want.at(id);
+        check(!patched.err && keptAsIs && samePointClouds(got, want), "point clouds: a patched object keeps the other entries as they were");
+    });
+}
+
+// box part layouts as documented in l_chunk.cpp: 0 is 9 floats per box, 1 is 6 x u16 between
+// the chunk bounds and 3 x u8 rgb
+constexpr size_t COMPACT_BOX_SIZE = 15;
+
+// min xyz, max xyz, zeros without a bounds part
+static std::vector<float> readBounds(const PartStore& parts) {
+    std::vector<float> bounds(6);
+    const auto part = parts.get(LChunk::BOUNDS_PART_ID);
+    if (part.size() == 6 * sizeof(float))
+        std::memcpy(bounds.data(), part.data(), part.size());
+    return bounds;
+}
+
+static std::vector<float> parseBoxes(std::span<const uint8_t> part, uint8_t layout, const std::vector<float>& bounds) {
+    if (layout == 0) {
+        std::vector<float> boxes(part.size() / sizeof(float));
+        std::memcpy(boxes.data(), part.data(), boxes.size() * sizeof(float));
+        return boxes;
+    }
+    std::vector<float> boxes;
+    for (size_t at = 0; at + COMPACT_BOX_SIZE <= part.size(); at += COMPACT_BOX_SIZE) {
+        for (size_t j = 0; j < 6; ++j) {
+            uint16_t q;
+            std::memcpy(&q, part.data() + at + j * 2, 2);
+            boxes.push_back(bounds[j % 3] + q * ((bounds[3 + j % 3] - bounds[j % 3]) / 65535.f));
+        }
+        for (size_t j = 0; j < 3; ++j)
+            boxes.push_back(part[at + 12 + j] / 255.f);
+    }
+    return boxes;
+}
+
+// the part bytes for boxes, the inverse of parseBoxes on its own grid
+static std::vector<uint8_t> packBoxes(const std::vector<float>& boxes, uint8_t layout, const std::vector<float>& bounds) {
+    std::vector<uint8_t> out;
+    if (layout == 0) {
+        out.resize(boxes.size() * sizeof(float));
+        std::memcpy(out.data(), boxes.data(), out.size());
+        return out;
+    }
+    for (size_t at = 0; at + 9 <= boxes.size(); at += 9) {
+        for (size_t j = 0; j < 6; ++j) {
+            const float range = bounds[3 + j % 3] - bounds[j % 3];
+            const float v = range > 0.f ? (boxes[at + j] - bounds[j % 3]) * (65535.f / range) : 0.f;
+            const uint16_t q = static_cast<uint16_t>(std::lround(std::clamp(v, 0.f, 65535.f)));
+            out.insert(out.end(), reinterpret_cast<const uint8_t*>(&q), reinterpret_cast<const uint8_t*>(&q) + 2);
+        }
+        for (size_t j = 0; j < 3; ++j)
+            out.push_back(static_cast<uint8_t>(std::lround(std::clamp(boxes[at + 6 + j], 0.f, 1.f) * 255.f)));
+    }
+    return out;
+}
+
+// up to a step of the grid, the top of it can round past max
+static bool within(const std::vector<float>& boxes, const std::vector<float>& bounds) {
+    for (size_t at = 0; at + 9 <= boxes.size(); at += 9)
+        for (size_t j = 0; j < 6; ++j) {
+            const float step = (bounds[3 + j % 3] - bounds[j % 3]) / 65535.f;
+            if (boxes[at + j] < bounds[j % 3] - step || boxes[at + j] > bounds[3 + j % 3] + step)
+                return false;
+        }
+    return true;
+}
+
+static asio::awaitable<void> putChild(std::shared_ptr<CFAsyncClient> cfCli, std::mt19937& rng, uint64_t id, float scale) {
+    PointCloudChunk child(Chunk::makeIdStr(4, id, true), {});
+    addPointCloud(child.pointClouds(), 0, randomPoints(rng, 400, scale));
+    co_await child.upload(cfCli);
+}
+
+static asio::awaitable<void> updateBoxes(std::shared_ptr<CFAsyncClient> cfCli, std::string chunkId, std::vector<std::string> needsUpdate) {
+    PointCloudChunk chunk(std::move(chunkId), std::move(needsUpdate));
+    co_await chunk.prep(cfCli);
+    chunk.process();
+    co_await chunk.uploadBoxes(cfCli);
+}
+
+// kept boxes are at most steps grid steps of bounds away from want
+static bool near(const std::vector<float>& boxes, const std::vector<float>& want, const std::vector<float>& bounds, float steps) {
+    if (boxes.size() != want.size())
+        return false;
+    for (size_t at = 0; at + 9 <= boxes.size(); at += 9)
+        for (size_t j = 0; j < 6; ++j)
+            if (std::abs(boxes[at + j] - want[at + j]) > steps * (bounds[3 + j % 3] - bounds[j % 3]) / 65535.f)
+                return false;
+    return true;
+}
+
+// boxes of an L chunk decode the same through LChunk::decodeBoxes and the documented layout.
+// updates inside the bounds leave the other parts as they were, growing the bounds requantizes
+// kept compact boxes within the documented error and leaves float boxes as they were
+static void boxes() {
+    runAsync("boxes", [](asio::io_context&) -> asio::awaitable<void> {
+        auto cfCli = std::make_shared<CFAsyncClient>(std::make_unique<LocalObjectStore>(scratch("box-store")), "", 4);
+        const auto parentId = Chunk::makeIdStr(3, 0, true);
+        std::mt19937 rng(13);
+        co_await putChild(cfCli, rng, 1, 10);
+        co_await putChild(cfCli, rng, 2, 5);
+        const std::vector<std::string> both{"1", "2"}, first{"1"}, second{"2"};
+        co_await updateBoxes(cfCli, parentId, both);
+
+        PointCloudChunk before(parentId, {});
+        co_await before.downloadBoxes(cfCli);
+        const uint8_t layout = before.parts().layout();
+        const auto bounds = readBounds(before.parts());
+        bool same = layout == (CONFIG::COMPACT_BOXES ? 1 : 0) && before.parts().contains(1) && before.parts().contains(2);
+        for (const auto& e : before.parts()) {
+            if (e.id == LChunk::BOUNDS_PART_ID)
+                continue;
+            const auto decoded = LChunk::decodeBoxes(before.parts(), e.id);
+            same &= decoded == parseBoxes(e.data, layout, bounds) && std::ranges::equal(packBoxes(decoded, layout, bounds), e.data);
+            same &= layout == 0 || within(decoded, bounds);
+        }
+        check(same, fmt::format("boxes: decodeBoxes inverts layout {}", layout));
+
+        // child 2 changes inside the bounds, child 1's part is not touched
+        co_await putChild(cfCli, rng, 2, 5);
+        co_await updateBoxes(cfCli, parentId, second);
+        PointCloudChunk inside(parentId, {});
+        co_await inside.downloadBoxes(cfCli);
+        check(readBounds(inside.parts()) == bounds && std::ranges::equal(inside.parts().get(1), before.parts().get(1)),
+            "boxes: an update inside the bounds leaves the other parts as they were");
+
+        // child 1 grows past the bounds again and again, child 2 is kept. each growth moves its
+        // boxes by half a step of the new grid at most, all of them by (1 + h) / 2h steps of the
+        // last one
+        const auto keptBefore = LChunk::decodeBoxes(inside.parts(), 2);
+        const float h = CONFIG::COMPACT_BOXES_HEADROOM;
+        auto last = bounds;
+        auto lastKept = keptBefore;
+        auto lastPart = std::vector<uint8_t>(inside.parts().get(2).begin(), inside.parts().get(2).end());
+        bool grewOnce = false, untouched = true, stepped = true, allWithin = true;
+        float scale = 1000;
+        for (int i = 0; i < 20; ++i, scale *= 1.2f) {
+            co_await putChild(cfCli, rng, 1, scale);
+            co_await updateBoxes(cfCli, parentId, first);
+            PointCloudChunk after(parentId, {});
+            co_await after.downloadBoxes(cfCli);
+            const auto grown = readBounds(after.parts());
+            const auto kept = LChunk::decodeBoxes(after.parts(), 2);
+            const auto part = after.parts().get(2);
+            if (layout == 0 || grown == last)
+                untouched &= std::ranges::equal(part, lastPart);
+            else {
+                grewOnce = true;
+                stepped &= near(kept, lastKept, grown, 0.5f + 1e-3f);
+            }
+            allWithin &= layout == 0 || (within(kept, grown) && within(LChunk::decodeBoxes(after.parts(), 1), grown));
+            last = grown;
+            lastKept = kept;
+            lastPart.assign(part.begin(), part.end());
+        }
+        const bool drift = layout == 0 ? lastKept == keptBefore : near(lastKept, keptBefore, last, (1 + h) / (2 * h) + 1e-3f);
+        check(untouched && (layout == 0 || grewOnce), "boxes: kept parts are only rewritten when the bounds grow");
+        check(stepped && allWithin && drift, "boxes: kept boxes stay within the requantization error as the bounds grow");
+    });
+}
+
+int main() {
+    diskCacheRecord();
+    purgeEngineBackoff();
+    httpPoolReplay();
+    chunkParts();
+    plotUpdates();
+    plotMetaHeader();
+    splicer();
+    pointClouds();
+    boxes();
+
+    std::cout << (failures ? std::to_string(failures) + " failed" : "all passed") << std::endl;
+    return failures ? 1 : 0;
+}
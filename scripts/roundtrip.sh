@@ -0,0 +1,20 @@
+# Builds the format round-trip harness (roundtrip.cpp) and runs it twice: with the config as it
+# is, then with every format switch in config.hpp turned on
+# PRESET picks the cmake configure preset, arm-debug by default
+set -e
+cd "$(dirname "$0")/.."
+PRESET=${PRESET:-arm-debug}
+
+run() {
+    cmake --preset "$PRESET" -B "build/roundtrip-$1" -DTRRASVR_ROUNDTRIP=ON -DTRRASVR_CONFIG_DIR="$2"
+    cmake --build "build/roundtrip-$1" --target roundtrip
+    "build/roundtrip-$1/roundtrip"
+}
+
+run default ""
+
+FORMATS="$PWD/build/roundtrip-formats-config"
+mkdir -p "$FORMATS/config"
+sed -E 's/(COMPRESS_CHUNKS|QUANTIZE_POINT_CLOUDS|COMPACT_BOXES|PLOT_META_HEADER|CHUNK_FORMAT_INDEXED) = false/\1 = true/' \
+    include/config/config.hpp > "$FORMATS/config/config.hpp"
+run formats "$FORMATS"
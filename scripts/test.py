@@ -9,45 +9,61 @@ import os
 from dotenv import load_dotenv
 
 REDIS_UPDATE_QUEUE = "up:q:0"
-REDIS_UPDATE_NEEDS_UPDATE_PREFIX = "up:nu:"
-REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX = "up:nu:f:"
-REDIS_FLAG_UPDATE_METADATA_FIELDS_ONLY = "mfo"
-REDIS_FLAG_SET_DEFAULT_JSON = "sdj";
-REDIS_FLAG_SET_DEFAULT_BUILD = "sdb";
-REDIS_FLAG_NO_IMAGE_UPDATE = "niu";
+REDIS_UPDATE_NEEDS_UPDATE_PREFIX = "up:nu:" # up:nu:{chunk}
+REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX = "up:nu:f:" # up:nu:f:{chunk}, hash per chunk: plot id -> bitmask
+REDIS_FLAG_METADATA_ONLY = 1 << 0
+REDIS_FLAG_SET_DEFAULT_JSON = 1 << 1
+REDIS_FLAG_SET_DEFAULT_BUILD = 1 << 2
+REDIS_FLAG_NO_IMAGE_UPDATE = 1 << 3
 
 class UpdateFlags:
     def __init__(
         self,
+        metadata_only = False,
         default_json = False,
         default_build = False,
         no_img_update = False
     ):
+        self.metadata_only = metadata_only
         self.default_json = default_json
         self.default_build = default_build
         self.no_img_update = no_img_update
     
-    def __str__(self):
-        flags = []
+    def mask(self):
+        mask = 0
+        if self.metadata_only:
+            mask |= REDIS_FLAG_METADATA_ONLY
         if self.default_json:
-            flags.append(REDIS_FLAG_SET_DEFAULT_JSON)
+            mask |= REDIS_FLAG_SET_DEFAULT_JSON
         if self.default_build:
-            flags.append(REDIS_FLAG_SET_DEFAULT_BUILD)
+            mask |= REDIS_FLAG_SET_DEFAULT_BUILD
         if self.no_img_update:
-            flags.append(REDIS_FLAG_NO_IMAGE_UPDATE)
-
-        return " ".join(flags)
+            mask |= REDIS_FLAG_NO_IMAGE_UPDATE
+        return mask
     
 
 load_dotenv()
 
-r = redis.Redis( 
-    host='redis-16216.c15.us-east-1-4.ec2.redns.redis-cloud.com', 
-    port=16216, 
-    username='default', 
-    password=os.getenv("REDIS_PASSWORD"), 
-    db=0
-)
+# REDIS_HOST/REDIS_PORT/REDIS_CLUSTER=1 to target a local cluster (see cluster.sh)
+if os.getenv("REDIS_CLUSTER") == "1":
+    r = redis.RedisCluster(
+        host=os.getenv("REDIS_HOST", "127.0.0.1"),
+        port=int(os.getenv("REDIS_PORT", "7000"))
+    )
+else:
+    r = redis.Redis( 
+        host=os.getenv("REDIS_HOST", 'redis-16216.c15.us-east-1-4.ec2.redns.redis-cloud.com'), 
+        port=int(os.getenv("REDIS_PORT", "16216")), 
+        username='default', 
+        password=os.getenv("REDIS_PASSWORD"), 
+        db=0
+    )
+
+def needs_update_key(chunk_id_str):
+    return REDIS_UPDATE_NEEDS_UPDATE_PREFIX + "{" + chunk_id_str + "}"
+
+def update_flags_key(chunk_id_str):
+    return REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX + "{" + chunk_id_str + "}"
 
 # Push chunk to queue
 
@@ -76,11 +92,14 @@ def flag_chunk(chunk_id):
     # Add plot to chunk's needs update list
     needs_update = [hex(plot_id)[2:] for plot_id in chunk_map[chunk_id]]
 
-    r.sadd(REDIS_UPDATE_NEEDS_UPDATE_PREFIX + chunk_id_str, *needs_update)
+    r.sadd(needs_update_key(chunk_id_str), *needs_update)
 
-    # Store plot's update flagsREDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX
+    # Store plot update flags, OR-ing into any flags already queued for the plot
     flags = UpdateFlags()
-    # r.sadd(REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX + "8693", "HELLO");
+    for plot_id in needs_update:
+        key = update_flags_key(chunk_id_str)
+        prev = int(r.hget(key, plot_id) or 0)
+        r.hset(key, plot_id, prev | flags.mask())
 
     r.lpush(REDIS_UPDATE_QUEUE, chunk_id_str)
 
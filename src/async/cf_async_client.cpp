@@ -2,6 +2,11 @@
 #include <memory>
 #include <vector>
 #include <unordered_map>
+#include <string>
+#include <optional>
+#include <random>
+#include <algorithm>
+#include <chrono>
 
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/use_awaitable.hpp>   
@@ -13,210 +18,571 @@
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/post.hpp>
 #include <boost/asio/detached.hpp>
-#include <cpr/cpr.h>
-#include <aws/core/Aws.h>
-#include <aws/s3/model/HeadObjectRequest.h>
-#include <aws/s3/model/HeadObjectResult.h>
-#include <aws/s3/model/GetObjectRequest.h>
-#include <aws/s3/model/PutObjectRequest.h>
-#include <aws/s3/model/GetObjectResult.h>
-#include <aws/s3/model/PutObjectResult.h>
-#include <aws/s3/S3Client.h>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <nlohmann/json.hpp>
+#include <fmt/format.h>
 
 #include "async/cf_async_client.hpp"
 #include "config/config.hpp"
 
 CFAsyncClient::CFAsyncClient(
-    const std::string& r2EndPoint,
-    const std::string& r2AccessKey,
-    const std::string& r2SecretKey,
+    std::unique_ptr<ObjectStore> store,
     const std::string& cfApiToken,
     size_t concurrency,
     bool cacheEnabled,
-    size_t cacheCapacity
-) : _threadPool(asio::thread_pool(concurrency)), _cfApiToken(cfApiToken), 
-_cacheEnabled(cacheEnabled), _cacheCapacity(cacheCapacity), _cacheSize(0ul) {
-    Aws::Client::ClientConfiguration config;
-    config.region = "auto";
-    config.endpointOverride = r2EndPoint;
-    config.scheme = Aws::Http::Scheme::HTTPS;
-    config.maxConnections = concurrency;
-    config.enableTcpKeepAlive = true;
-
-    Aws::Auth::AWSCredentials creds(r2AccessKey, r2SecretKey);
-
-    _s3Cli = std::make_shared<Aws::S3::S3Client>(
-        creds,
-        config,
-        Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never,
-        false
-    );
+    const std::unordered_map<std::string, size_t>& cacheBudgets,
+    const std::string& cfApiEndPoint
+) : _store(std::move(store)), _threadPool(asio::thread_pool(concurrency)), _cfApiToken(cfApiToken), 
+_cacheEnabled(cacheEnabled), _scheduler(CONFIG::R2_MAX_IN_FLIGHT) {
+    // separate budgets so large point clouds can't crowd out chunks
+    for (const auto& [bucket, capacity] : cacheBudgets)
+        _caches.emplace(bucket, std::make_unique<ObjectCache>(capacity, CONFIG::R2_CACHE_SHARDS));
+
+    if (!cfApiEndPoint.empty())
+        _cfApi = std::make_unique<HttpPool>(HttpPool::parseOrigin(cfApiEndPoint), CONFIG::PURGE_MAX_IN_FLIGHT);
+
+    if (_cacheEnabled && CONFIG::DISK_CACHE_SIZE > 0)
+        _diskCache = std::make_unique<DiskCache>(
+            CONFIG::DISK_CACHE_DIR, 
+            CONFIG::DISK_CACHE_SIZE << 20, 
+            CONFIG::DISK_CACHE_SEGMENT_SIZE << 20
+        );
 }
 
 CFAsyncClient::~CFAsyncClient() {
     _threadPool.join();
 }
 
+void CFAsyncClient::recordLatency(double ms) {
+    _latencies[_latencyPos++ % _latencies.size()] = ms;
+
+    // refresh the hedge threshold every so often rather than sorting per request
+    if (_latencyPos % 64 != 0 || _latencyPos < _latencies.size() / 4)
+        return;
+    std::vector<double> window(_latencies.begin(), _latencies.begin() + std::min(_latencyPos, _latencies.size()));
+    const auto nth = window.begin() + static_cast<size_t>(CONFIG::R2_HEDGE_PERCENTILE * (window.size() - 1));
+    std::nth_element(window.begin(), nth, window.end());
+    _hedgeDelayMs = std::max(*nth, static_cast<double>(CONFIG::R2_HEDGE_MIN_MS));
+}
+
+// one round of attempts: the first success wins, an error only once every attempt has failed
+template<typename Outcome>
+struct Race {
+    asio::steady_timer done; // cancelled once result is set
+    std::chrono::steady_clock::time_point deadline;
+    std::optional<Outcome> result;
+    std::optional<Outcome> failed; // an error held back while other attempts are pending
+    size_t pending = 0;
+
+    Race(const asio::any_io_executor& exec, std::chrono::steady_clock::time_point deadline)
+        : done(exec, asio::steady_timer::time_point::max()), deadline(deadline) {}
+
+    // called once per attempt, res is empty for attempts that never sent their request
+    bool settle(std::optional<Outcome> res) {
+        pending--;
+        if (result)
+            return false;
+        if (res && res->err && pending > 0)
+            failed = std::move(res);
+        else if (res)
+            result = std::move(res);
+        else if (pending == 0 && failed)
+            result = std::move(failed);
+        if (!result)
+            return false;
+        done.cancel();
+        return true;
+    }
+};
+
+template<typename Outcome, typename Attempt>
+asio::awaitable<Outcome> CFAsyncClient::withRetries(Attempt attempt, const RequestContext& ctx, bool hedge) {
+    using clock = std::chrono::steady_clock;
+    const auto exec = co_await asio::this_coro::executor;
+    std::optional<clock::time_point> deadline; // starts once the first attempt holds a slot
+    _r2Stats.requests++;
+
+    const auto deadlineExceeded = []() {
+        Outcome out;
+        out.err = true;
+        out.errType = Aws::S3::S3Errors::REQUEST_TIMEOUT;
+        out.retryable = true;
+        out.errMsg = fmt::format("R2 request deadline of {} ms exceeded", CONFIG::R2_DEADLINE_MS);
+        return out;
+    };
+
+    // attempts run detached so a deadline or a hedge never has to wait for a slow one. a round's
+    // first attempt comes with its slot, so time queued in the scheduler is never taken for a
+    // slow request, hedges queue for theirs
+    const auto launch = [this, &exec, &attempt, ctx, hedge](std::shared_ptr<Race<Outcome>> race, RequestScheduler::Slot slot, bool isHedge) {
+        race->pending++;
+        _r2Stats.attempts++;
+        asio::co_spawn(exec, [this, race, attempt, ctx, hedge, isHedge, slot = std::move(slot)]() mutable -> asio::awaitable<void> {
+            if (isHedge) {
+                slot = co_await _scheduler.acquire(ctx.job, ctx.priority);
+                // the other attempt won or the caller gave up while this one was queued
+                if (race->result || clock::now() >= race->deadline) {
+                    race->settle(std::nullopt);
+                    co_return;
+                }
+            }
+            const auto start = clock::now();
+            Outcome res;
+            try {
+                res = co_await attempt();
+            } catch (const std::exception& e) {
+                res.err = true;
+                res.retryable = true;
+                res.errMsg = std::string("R2 request error: ") + e.what();
+            }
+            if (!res.err && hedge)
+                recordLatency(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            const bool won = !res.err;
+            if (race->settle(std::move(res)) && won && isHedge)
+                _r2Stats.hedgeWins++;
+        }, asio::detached);
+    };
+
+    const auto wait = [](std::shared_ptr<Race<Outcome>> race, clock::time_point until) -> asio::awaitable<void> {
+        if (race->result)
+            co_return;
+        race->done.expires_at(until);
+        boost::system::error_code ec;
+        co_await race->done.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    };
+
+    for (size_t retry = 0;; ++retry) {
+        auto slot = co_await _scheduler.acquire(ctx.job, ctx.priority);
+        if (!deadline)
+            deadline = clock::now() + std::chrono::milliseconds(CONFIG::R2_DEADLINE_MS);
+        else if (clock::now() >= *deadline) {
+            _r2Stats.deadlines++;
+            co_return deadlineExceeded();
+        }
+
+        auto race = std::make_shared<Race<Outcome>>(exec, *deadline);
+        launch(race, std::move(slot), false);
+
+        // hedge: a second identical request once the first is slower than most
+        if (hedge && _hedgeDelayMs > 0) {
+            const auto hedgeAt = clock::now() + std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double, std::milli>(_hedgeDelayMs)
+            );
+            co_await wait(race, std::min(hedgeAt, *deadline));
+            if (!race->result && clock::now() < *deadline) {
+                _r2Stats.hedges++;
+                launch(race, RequestScheduler::Slot{}, true);
+            }
+        }
+        co_await wait(race, *deadline);
+
+        if (!race->result) {
+            _r2Stats.deadlines++;
+            co_return deadlineExceeded();
+        }
+
+        auto out = std::move(*race->result);
+        if (!out.err || !out.retryable || retry >= CONFIG::R2_MAX_RETRIES) {
+            if (out.err)
+                _r2Stats.errors++;
+            co_return out;
+        }
+
+        // full jitter exponential backoff, give up early if the wait would pass the deadline
+        const int64_t cap = std::min(CONFIG::R2_RETRY_MAX_MS, CONFIG::R2_RETRY_BASE_MS << retry);
+        const auto backoff = std::chrono::milliseconds(std::uniform_int_distribution<int64_t>(0, cap)(_rng));
+        if (clock::now() + backoff >= *deadline) {
+            _r2Stats.errors++;
+            co_return out;
+        }
+
+        _r2Stats.retries++;
+        asio::steady_timer timer(exec, backoff);
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+}
+
 asio::awaitable<CFAsyncClient::GetOutcome> CFAsyncClient::getR2Object(
     const std::string& bucket, 
     const std::string& key,
-    const bool useCache
+    const bool useCache,
+    const RequestContext& ctx
 ) {
     const std::string cacheKey = bucket+key;
-    if (_cacheEnabled && useCache && _cache.contains(cacheKey)) {
-        std::cout << "cache hit " << cacheKey << std::endl;
-        co_return _cache[cacheKey].second;
+    // dirty write-back entries are newer than R2, with or without the cache
+    if (const auto it = _dirty.find(cacheKey); it != _dirty.end())
+        co_return GetOutcome::fromObject(it->second.obj);
+
+    ObjectCache* cache = useCache ? cacheFor(bucket) : nullptr;
+    std::shared_ptr<const CachedObject> hit;
+    if (cache) {
+        hit = cache->get(key);
+        // share the cached buffer, no copy
+        if (hit && !CONFIG::R2_CACHE_REVALIDATE)
+            co_return GetOutcome::fromObject(std::move(hit));
     }
 
-    co_return co_await asio::co_spawn(
-        _threadPool.get_executor(), 
-        [s3Cli = _s3Cli, bucket, key]() mutable -> asio::awaitable<GetOutcome> {
-            Aws::S3::Model::GetObjectRequest req;
-            req.SetBucket(bucket);
-            req.SetKey(key);
-
-            const auto out = s3Cli->GetObject(req);
-
-            GetOutcome obj;
-
-            if (out.IsSuccess()) {
-                const auto& res = out.GetResult();
-                for (const auto& [k, v] : res.GetMetadata())
-                    obj.metadata[k] = v;
-                auto& body = res.GetBody();  
-                obj.body.reserve(res.GetContentLength());
-                obj.body.assign(std::istreambuf_iterator<char>(body), std::istreambuf_iterator<char>());        
-            } else {
-                obj.err = true;
-                const auto& err = out.GetError();
-                obj.errType = err.GetErrorType();
-                obj.errMsg = "R2 GetObject error: " + err.GetMessage();
-            }
+    // single flight: concurrent GETs for the same object wait on the first one's transfer
+    if (const auto it = _inFlight.find(cacheKey); it != _inFlight.end()) {
+        const auto flight = it->second;
+        boost::system::error_code ec;
+        co_await flight->done.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+        co_return *flight->result;
+    }
 
-            co_return obj;
-        }, asio::use_awaitable);
-        
-}
+    const auto flight = std::make_shared<InFlight>(co_await asio::this_coro::executor);
+    _inFlight.emplace(cacheKey, flight);
+
+    try {
+        // memory miss, try the disk tier before going to R2
+        if (!hit && _diskCache && cache) {
+            hit = co_await diskGet(cacheKey);
+            if (hit)
+                cache->put(key, hit);
+        }
+
+        if (hit && !CONFIG::R2_CACHE_REVALIDATE)
+            flight->result = GetOutcome::fromObject(hit);
+        else {
+            // when revalidating, the body is only transferred if it changed since it was cached
+            auto obj = co_await withRetries<GetOutcome>([this, bucket, key, etag = hit ? hit->etag : ""]() {
+                return _store->get(bucket, key, etag);
+            }, ctx, true);
+            if (obj.notModified)
+                obj = GetOutcome::fromObject(hit);
+            else if (hit && !obj.err)
+                cachePut(bucket, key, obj.owner); // replace the stale copy
+            else if (hit && obj.errType == Aws::S3::S3Errors::NO_SUCH_KEY)
+                cache->erase(key);
+            flight->result = std::move(obj);
+        }
+    } catch (const std::exception& e) {
+        GetOutcome obj;
+        obj.err = true;
+        obj.errMsg = std::string("R2 GetObject error: ") + e.what();
+        flight->result = std::move(obj);
+    }
 
+    _inFlight.erase(cacheKey);
+    flight->done.cancel(); // wake waiters
+    co_return *flight->result;
+}
 
-asio::awaitable<CFAsyncClient::GetOutcome> CFAsyncClient::headR2Object(
+asio::awaitable<CFAsyncClient::GetOutcome> CFAsyncClient::getR2ObjectRange(
     const std::string& bucket,
-    const std::string& key
+    const std::string& key,
+    uint64_t offset,
+    uint64_t length,
+    const bool useCache,
+    const RequestContext& ctx
 ) {
-    // note: no cache here, put never writes metadata
-    co_return co_await asio::co_spawn(
-        _threadPool.get_executor(), 
-        [s3Cli = _s3Cli, bucket, key]() mutable -> asio::awaitable<GetOutcome> {
-            Aws::S3::Model::HeadObjectRequest req;
-            req.SetBucket(bucket);
-            req.SetKey(key);
-
-            const auto out = s3Cli->HeadObject(req);
-            GetOutcome obj;
-
-            if (out.IsSuccess()) {
-                const auto& res = out.GetResult();
-                for (const auto& [k, v] : res.GetMetadata())
-                    obj.metadata[k] = v;
-            } else {
-                obj.err = true;
-                const auto& err = out.GetError();
-                obj.errType = err.GetErrorType();
-                obj.errMsg = "R2 GetObject error: " + err.GetMessage();
+    ObjectCache* cache = useCache ? cacheFor(bucket) : nullptr;
+    if (cache) {
+        // slice the cached buffer under the same rules getR2Object serves hits by
+        auto hit = cache->get(key);
+        if (hit && (!CONFIG::R2_CACHE_REVALIDATE || _dirty.contains(bucket+key))) {
+            auto out = GetOutcome::fromObject(std::move(hit));
+            if (offset >= out.body.size()) {
+                GetOutcome err;
+                err.err = true;
+                err.errMsg = fmt::format("R2 GetObject range error: offset {} past the end of {}", offset, key);
+                co_return err;
             }
+            out.body = out.body.subspan(offset, std::min<uint64_t>(length, out.body.size() - offset));
+            co_return out;
+        }
+    }
 
-            co_return obj;
-        }, asio::use_awaitable);
+    // not hedged, small ranges would drag the GET latency percentile down
+    co_return co_await withRetries<GetOutcome>([this, bucket, key, offset, length]() {
+        return _store->getRange(bucket, key, offset, length);
+    }, ctx, false);
 }
 
+asio::awaitable<CFAsyncClient::GetOutcome> CFAsyncClient::headR2Object(
+    const std::string& bucket,
+    const std::string& key,
+    const RequestContext& ctx
+) {
+    // a dirty write-back entry is what R2 will hold, it has no etag until flushed
+    if (const auto it = _dirty.find(bucket + key); it != _dirty.end()) {
+        auto out = GetOutcome::fromObject(it->second.obj);
+        out.body = {};
+        out.owner = nullptr;
+        co_return out;
+    }
+
+    // note: no cache here, put never writes metadata
+    co_return co_await withRetries<GetOutcome>([this, bucket, key]() {
+        return _store->head(bucket, key);
+    }, ctx, false);
+}
 
 asio::awaitable<CFAsyncClient::PutOutcome> CFAsyncClient::putR2Object(
     const std::string& bucket,
     const std::string& key,
     const std::string& contentType,
     std::vector<uint8_t>&& data,
-    const bool useCache
+    const bool useCache,
+    const RequestContext& ctx,
+    const bool writeBack
 ) {
-    co_return co_await asio::co_spawn(
-        _threadPool.get_executor(), 
-        [this, bucket, key, contentType, data = std::move(data), useCache]() mutable -> asio::awaitable<PutOutcome> {
-            Aws::S3::Model::PutObjectRequest req;
-            req.SetBucket(bucket);
-            req.SetKey(key);
-
-            auto body = Aws::MakeShared<Aws::StringStream>("PutR2ObjectBody");
-            body->write(
-                reinterpret_cast<const char*>(data.data()), 
-                static_cast<std::streamsize>(data.size())
-            );
-            body->seekg(0);
-            req.SetBody(body);
-            req.SetContentLength(data.size());
-            req.SetContentType(contentType);
-
-            const auto out = _s3Cli->PutObject(req);
-            PutOutcome obj;
-            
-            if (!out.IsSuccess()) {
-                const auto& err = out.GetError();
-                obj.err = true;
-                obj.errType = err.GetErrorType();
-                obj.errMsg = "R2 PutObject error: " + err.GetMessage();
-            } else if (_cacheEnabled && useCache) {
-                const std::string cacheKey = bucket + key;
-                std::cout << "Cache put " << cacheKey << std::endl;
-
-                // if key already cached, move to front of lru
-                if (_cache.contains(cacheKey)) {
-                    const auto& existingIter = _cache[cacheKey].first;
-                    auto& existingData = _cache[cacheKey].second.body;
-
-                    _cacheSize += data.size();
-                    _cacheSize -= existingData.size();
-
-                    _cacheEvictQueue.splice(_cacheEvictQueue.begin(), _cacheEvictQueue, existingIter); // move to front
-                    existingData = std::move(data); // update data
-                // insert item
-                } else {
-                    _cacheSize += data.size() + sizeof(GetOutcome);
-
-                    GetOutcome cacheItem;
-                    cacheItem.body = std::move(data);
-                    _cacheEvictQueue.push_front(cacheKey);
-                    _cache[cacheKey] = {_cacheEvictQueue.begin(), std::move(cacheItem)};
-                }
+    // write-back: the cached copy becomes authoritative and the PUT is deferred, so repeated
+    // writes within the window coalesce into one
+    ObjectCache* cache = cacheFor(bucket);
+    if (writeBack && CONFIG::R2_WRITE_BACK && cache && !_writeBackStopping) {
+        auto cached = std::make_shared<CachedObject>();
+        cached->body = std::move(data);
+        const size_t size = cached->body.size();
+        const std::string cacheKey = bucket + key;
+
+        auto [it, created] = _dirty.try_emplace(cacheKey);
+        auto& entry = it->second;
+        if (created) {
+            entry.bucket = bucket;
+            entry.key = key;
+            entry.since = std::chrono::steady_clock::now();
+            entry.pin = ObjectCache::Pin(cache, key);
+        } else {
+            _dirtyBytes -= entry.obj->body.size();
+            _wbStats.coalesced++;
+        }
+        entry.contentType = contentType;
+        entry.obj = cached;
+        _dirtyBytes += size;
+        _wbStats.writes++;
+
+        cache->put(key, std::move(cached));
+        co_return PutOutcome{};
+    }
 
-                // clean up cache
-                while (_cacheSize > _cacheCapacity) {
-                    const std::string& evict = _cacheEvictQueue.back();
-                    _cacheSize -= _cache[evict].second.body.size() + sizeof(GetOutcome);
-                    _cache.erase(evict);
-                    _cacheEvictQueue.pop_back();
-                }
-            }
+    // a plain write supersedes a dirty copy of the key, which would otherwise overwrite it when
+    // flushed. a flush already running goes first so it can't land after this write
+    if (_dirty.contains(bucket + key)) {
+        asio::steady_timer timer(co_await asio::this_coro::executor);
+        auto it = _dirty.find(bucket + key);
+        while (it != _dirty.end() && it->second.flushing) {
+            timer.expires_after(std::chrono::milliseconds(10));
+            co_await timer.async_wait(asio::use_awaitable);
+            it = _dirty.find(bucket + key);
+        }
+        if (it != _dirty.end()) {
+            _dirtyBytes -= it->second.obj->body.size();
+            _dirty.erase(it);
+            if (cache && !useCache)
+                cache->erase(key);
+        }
+    }
+
+    // shared with the attempts, one may still be running after the deadline has passed
+    auto body = std::make_shared<std::vector<uint8_t>>(std::move(data));
+    auto obj = co_await withRetries<PutOutcome>([this, bucket, key, contentType, body]() {
+        return _store->put(bucket, key, contentType, body);
+    }, ctx, false);
+
+    // attempts run one at a time, so the body is no longer in use after a success
+    if (!obj.err && useCache) {
+        auto cached = std::make_shared<CachedObject>();
+        cached->body = std::move(*body);
+        cached->etag = obj.etag;
+        cachePut(bucket, key, std::move(cached));
+    }
+    co_return obj;
+}
+
+ObjectCache* CFAsyncClient::cacheFor(const std::string& bucket) const {
+    if (!_cacheEnabled)
+        return nullptr;
+    const auto it = _caches.find(bucket);
+    return it == _caches.end() ? nullptr : it->second.get();
+}
+
+ObjectCache::Pin CFAsyncClient::pinR2Object(const std::string& bucket, const std::string& key) {
+    return ObjectCache::Pin(cacheFor(bucket), key);
+}
+
+asio::awaitable<void> CFAsyncClient::keepWarm(const std::string& bucket, const std::atomic<bool>& stop) {
+    co_await _store->keepWarm(bucket, stop);
+}
+
+HttpPool::Stats CFAsyncClient::connectionStats() const {
+    return _store->connectionStats();
+}
+
+CFAsyncClient::R2Stats CFAsyncClient::r2Stats() const {
+    auto stats = _r2Stats;
+    stats.hedgeDelayMs = _hedgeDelayMs;
+    return stats;
+}
+
+RequestScheduler::Stats CFAsyncClient::schedulerStats() const {
+    return _scheduler.stats();
+}
+
+std::vector<CFAsyncClient::CacheStats> CFAsyncClient::cacheStats() const {
+    std::vector<CacheStats> out;
+    for (const auto& [bucket, cache] : _caches)
+        for (const auto& [layer, counters] : cache->stats())
+            out.push_back({bucket, layer, counters});
+
+    if (_diskCache) {
+        ObjectCache::Counters disk;
+        disk.entries = _diskCache->entries();
+        disk.bytes = _diskCache->bytes();
+        out.push_back({"disk", "all", disk});
+    }
+    return out;
+}
+
+void CFAsyncClient::cachePut(const std::string& bucket, const std::string& key, std::shared_ptr<const CachedObject> obj) {
+    ObjectCache* cache = cacheFor(bucket);
+    if (!cache)
+        return;
+
+    cache->put(key, obj);
+    diskPut(bucket + key, std::move(obj));
+}
+
+void CFAsyncClient::diskPut(const std::string& cacheKey, std::shared_ptr<const CachedObject> obj) {
+    // write through to disk off the caller's thread, the version keeps out of order writes from
+    // replacing a newer body
+    if (_diskCache) {
+        const uint64_t version = _diskCache->nextVersion();
+        asio::post(_threadPool, [disk = _diskCache.get(), cacheKey, obj = std::move(obj), version]() {
+            disk->put(cacheKey, *obj, version);
+        });
+    }
+}
+
+asio::awaitable<void> CFAsyncClient::flushDirty(std::string cacheKey) {
+    const auto found = _dirty.find(cacheKey);
+    if (found == _dirty.end() || found->second.flushing)
+        co_return;
+    auto& entry = found->second;
+    entry.flushing = true;
+    const auto obj = entry.obj;
+    const std::string bucket = entry.bucket, key = entry.key, contentType = entry.contentType;
+
+    // aliases the cached body, no copy
+    const std::shared_ptr<const std::vector<uint8_t>> body(obj, &obj->body);
+    const auto out = co_await withRetries<PutOutcome>([this, bucket, key, contentType, body]() {
+        return _store->put(bucket, key, contentType, body);
+    }, RequestContext{0, RequestScheduler::Priority::Critical}, false);
+
+    auto it = _dirty.find(cacheKey);
+    it->second.flushing = false;
+    if (out.err) {
+        _wbStats.flushErrors++;
+        std::cerr << "[write-back] flush failed for " << cacheKey << ": " << out.errMsg << std::endl;
+        co_return;
+    }
+    _wbStats.flushes++;
+    diskPut(cacheKey, obj);
+
+    // rewritten while the flush was running, the newer version stays dirty
+    if (it->second.obj == obj) {
+        _dirtyBytes -= obj->body.size();
+        _dirty.erase(it);
+    }
+
+    if (_flushHook)
+        _flushHook(bucket, key);
+}
+
+asio::awaitable<void> CFAsyncClient::writeBackLoop() {
+    using clock = std::chrono::steady_clock;
+    const auto exec = co_await asio::this_coro::executor;
+    asio::steady_timer timer(exec);
+
+    while (!_writeBackStopping) {
+        timer.expires_after(std::chrono::seconds(1));
+        co_await timer.async_wait(asio::use_awaitable);
+
+        const auto now = clock::now();
+        const auto window = std::chrono::milliseconds(CONFIG::R2_WRITE_BACK_WINDOW_MS);
+
+        // oldest first, so memory pressure flushes the coldest writes
+        std::vector<std::pair<clock::time_point, std::string>> candidates;
+        for (const auto& [cacheKey, entry] : _dirty)
+            if (!entry.flushing)
+                candidates.emplace_back(entry.since, cacheKey);
+        std::sort(candidates.begin(), candidates.end());
+
+        size_t pending = _dirtyBytes;
+        for (const auto& [since, cacheKey] : candidates) {
+            const bool expired = now - since >= window;
+            const bool pressure = pending > (CONFIG::R2_WRITE_BACK_MAX_DIRTY << 20);
+            if (!expired && !pressure)
+                break;
+            pending -= _dirty.at(cacheKey).obj->body.size();
+            asio::co_spawn(exec, flushDirty(cacheKey), asio::detached);
+        }
+    }
+}
+
+asio::awaitable<void> CFAsyncClient::flushWriteBack() {
+    const auto exec = co_await asio::this_coro::executor;
+    asio::steady_timer timer(exec);
+    _writeBackStopping = true;
+
+    // a few rounds so transient failures get another go
+    for (size_t round = 0; round < CONFIG::R2_MAX_RETRIES && !_dirty.empty(); ++round) {
+        for (const auto& [cacheKey, entry] : _dirty)
+            if (!entry.flushing)
+                asio::co_spawn(exec, flushDirty(cacheKey), asio::detached);
+
+        const auto flushing = [this]() {
+            return std::any_of(_dirty.begin(), _dirty.end(), [](const auto& e) { return e.second.flushing; });
+        };
+        while (flushing()) {
+            timer.expires_after(std::chrono::milliseconds(100));
+            co_await timer.async_wait(asio::use_awaitable);
+        }
+    }
+
+    if (!_dirty.empty())
+        std::cerr << "[write-back] " << _dirty.size() << " objects could not be flushed" << std::endl;
+}
+
+void CFAsyncClient::setFlushHook(std::function<void(const std::string&, const std::string&)> hook) {
+    _flushHook = std::move(hook);
+}
+
+CFAsyncClient::WriteBackStats CFAsyncClient::writeBackStats() const {
+    auto stats = _wbStats;
+    stats.dirty = _dirty.size();
+    stats.dirtyBytes = _dirtyBytes;
+    return stats;
+}
 
-            co_return obj;
+asio::awaitable<std::shared_ptr<const CachedObject>> CFAsyncClient::diskGet(const std::string& cacheKey) {
+    co_return co_await asio::co_spawn(
+        _threadPool.get_executor(),
+        [disk = _diskCache.get(), cacheKey]() -> asio::awaitable<std::shared_ptr<const CachedObject>> {
+            co_return disk->get(cacheKey);
         }, asio::use_awaitable
     );
 }
 
-asio::awaitable<std::vector<CFAsyncClient::GetOutcome>> CFAsyncClient::getManyR2Objects(std::vector<GetParams>&& requests) {
+asio::awaitable<std::vector<CFAsyncClient::GetOutcome>> CFAsyncClient::getManyR2Objects(std::vector<GetParams>&& requests, const RequestContext& ctx) {
 
     auto exe = co_await asio::this_coro::executor;
     asio::experimental::channel<void(boost::system::error_code, int)> channel(exe, requests.size());
     std::vector<GetOutcome> results(requests.size());
 
-    // parallelize request
+    // parallelize request, the scheduler bounds how many actually run
     for (size_t i = 0; i < requests.size(); ++i)
         asio::co_spawn(
             exe,
-            [this, i, &requests, &channel, &results]() -> asio::awaitable<void> {
+            [this, i, &requests, &channel, &results, &ctx]() -> asio::awaitable<void> {
                 const auto& params = requests[i];
                 if (params.headOnly)
-                    results[i] = co_await headR2Object(params.bucket, params.key);
+                    results[i] = co_await headR2Object(params.bucket, params.key, ctx);
+                else if (params.rangeLength > 0)
+                    results[i] = co_await getR2ObjectRange(params.bucket, params.key, params.rangeOffset, params.rangeLength, params.useCache, ctx);
                 else
-                    results[i] = co_await getR2Object(params.bucket, params.key, params.useCache);
+                    results[i] = co_await getR2Object(params.bucket, params.key, params.useCache, ctx);
                 co_await channel.async_send({}, 0, asio::use_awaitable);
             },
             asio::detached
@@ -230,24 +596,25 @@ asio::awaitable<std::vector<CFAsyncClient::GetOutcome>> CFAsyncClient::getManyR2
     co_return results;
 }
 
-asio::awaitable<std::vector<CFAsyncClient::PutOutcome>> CFAsyncClient::putManyR2Objects(std::vector<PutParams>&& requests) {
+asio::awaitable<std::vector<CFAsyncClient::PutOutcome>> CFAsyncClient::putManyR2Objects(std::vector<PutParams>&& requests, const RequestContext& ctx) {
 
     auto exe = co_await asio::this_coro::executor;
     asio::experimental::channel<void(boost::system::error_code, int)> channel(exe, requests.size());
     std::vector<PutOutcome> results(requests.size());
 
-    // parallelize request
+    // parallelize request, the scheduler bounds how many actually run
     for (size_t i = 0; i < requests.size(); ++i)
         asio::co_spawn(
             exe,
-            [this, i, &requests, &channel, &results]() -> asio::awaitable<void> {
+            [this, i, &requests, &channel, &results, &ctx]() -> asio::awaitable<void> {
                 auto& params = requests[i];
                 results[i] = co_await putR2Object(
                     params.bucket, 
                     params.key, 
                     params.contentType, 
                     std::move(params.data), 
-                    params.useCache
+                    params.useCache,
+                    ctx
                 );
                 co_await channel.async_send({}, 0, asio::use_awaitable);
             },
@@ -263,59 +630,75 @@ asio::awaitable<std::vector<CFAsyncClient::PutOutcome>> CFAsyncClient::putManyR2
     
 };
 
-asio::awaitable<void> CFAsyncClient::purgeCache(const std::vector<std::string>&& urls) {
-    co_await asio::co_spawn(
-        _threadPool.get_executor(), 
-        [this, urls = std::move(urls)]() -> asio::awaitable<void> {
-            nlohmann::json payload;
-            nlohmann::json filesArray = nlohmann::json::array();
-
-            // Build the files array with proper structure
-            for (const auto& url : urls) {
-                filesArray.push_back({
-                    {"url", url},
-                    {"headers", {
-                        {"Origin", VARS::ORIGIN}
-                    }}
-                });
-            }
-            
-            payload["files"] = filesArray;
-
-            static const std::string apiUrl = 
-                "https://api.cloudflare.com/client/v4/zones/" + 
-                std::string(VARS::CF_ZONE_ID) + "/purge_cache";
-
-            cpr::Response r = cpr::Post(
-                cpr::Url{apiUrl},
-                cpr::Header{
-                    {"Authorization", "Bearer " + _cfApiToken},
-                    {"Content-Type", "application/json"}
-                },
-                cpr::Body{payload.dump()}
-            );
+asio::awaitable<CFAsyncClient::PurgeOutcome> CFAsyncClient::purgeCache(const std::vector<std::string>& urls) {
+    // nothing in front of a local store
+    if (!_cfApi)
+        co_return PurgeOutcome{};
+
+    nlohmann::json payload;
+    nlohmann::json filesArray = nlohmann::json::array();
+
+    // Build the files array with proper structure
+    for (const auto& url : urls) {
+        filesArray.push_back({
+            {"url", url},
+            {"headers", {
+                {"Origin", VARS::ORIGIN}
+            }}
+        });
+    }
+    
+    payload["files"] = filesArray;
+    const std::string body = payload.dump();
 
-            if (r.status_code != 200) {
-                std::cerr << "API request failed with status code " << r.status_code << ": " << r.text << std::endl;
-                co_return;
-            }
+    static const std::string path = "/client/v4/zones/" + std::string(VARS::CF_ZONE_ID) + "/purge_cache";
 
-            try {
-                nlohmann::json purgeRes = nlohmann::json::parse(r.text);
-                if (!purgeRes.value("success", false)) {
-                    std::string errorMsg = "Cloudflare API reported a failure.";
-                    if (purgeRes.contains("errors")) {
-                        errorMsg += " Errors: " + purgeRes["errors"].dump();
-                    }
-                    std::cerr << errorMsg << std::endl;
-                }
-            } catch (const nlohmann::json::parse_error& e) {
-                std::cerr << "Failed to parse JSON response: " 
-                         << e.what() << std::endl;
+    HttpPool::Request req{http::verb::post, path, 11};
+    req.set(http::field::host, _cfApi->origin().host);
+    req.set(http::field::authorization, "Bearer " + _cfApiToken);
+    req.set(http::field::content_type, "application/json");
+    req.body() = {reinterpret_cast<const uint8_t*>(body.data()), body.size()};
+
+    auto sent = co_await _cfApi->send(req);
+
+    PurgeOutcome out;
+    if (sent.err) {
+        out.err = true;
+        out.errMsg = "Purge request failed: " + sent.errMsg;
+        co_return out;
+    }
+
+    const auto& res = sent.res;
+    const std::string text(res.body().begin(), res.body().end());
+    if (res.result_int() == 429) {
+        out.err = true;
+        out.throttled = true;
+        out.errMsg = "Purge request rate limited";
+        try {
+            out.retryAfter = std::chrono::seconds(std::stoll(std::string(res[http::field::retry_after])));
+        } catch (const std::exception&) {}
+        co_return out;
+    }
+
+    if (res.result_int() != 200) {
+        out.err = true;
+        out.errMsg = fmt::format("API request failed with status code {}: {}", res.result_int(), text);
+        co_return out;
+    }
+
+    try {
+        nlohmann::json purgeRes = nlohmann::json::parse(text);
+        if (!purgeRes.value("success", false)) {
+            out.err = true;
+            out.errMsg = "Cloudflare API reported a failure.";
+            if (purgeRes.contains("errors")) {
+                out.errMsg += " Errors: " + purgeRes["errors"].dump();
             }
+        }
+    } catch (const nlohmann::json::parse_error& e) {
+        out.err = true;
+        out.errMsg = std::string("Failed to parse JSON response: ") + e.what();
+    }
 
-            co_return;
-        },
-        asio::use_awaitable
-    );
+    co_return out;
 }
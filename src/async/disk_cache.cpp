@@ -0,0 +1,329 @@
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <fmt/format.h>
+
+#include "async/disk_cache.hpp"
+
+// record: | magic | version | key len | meta len | body len | crc | key | meta | body |
+// meta: | count | (key len | key | val len | val)... | etag len | etag | last modified len | last modified |
+// crc covers everything after the header. older record layouts fail the magic check and are dropped
+static constexpr uint32_t RECORD_MAGIC = 0x32445254; // "TRD2"
+static constexpr size_t RECORD_HEADER_SIZE = 4 + 8 + 4 + 4 + 8 + 4;
+
+static uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    static constexpr auto table = []() {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int j = 0; j < 8; ++j)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+struct RecordHeader {
+    uint32_t magic;
+    uint64_t version;
+    uint32_t keyLen;
+    uint32_t metaLen;
+    uint64_t bodyLen;
+    uint32_t crc;
+
+    void write(uint8_t* p) const {
+        std::memcpy(p, &magic, 4);
+        std::memcpy(p + 4, &version, 8);
+        std::memcpy(p + 12, &keyLen, 4);
+        std::memcpy(p + 16, &metaLen, 4);
+        std::memcpy(p + 20, &bodyLen, 8);
+        std::memcpy(p + 28, &crc, 4);
+    }
+
+    void read(const uint8_t* p) {
+        std::memcpy(&magic, p, 4);
+        std::memcpy(&version, p + 4, 8);
+        std::memcpy(&keyLen, p + 12, 4);
+        std::memcpy(&metaLen, p + 16, 4);
+        std::memcpy(&bodyLen, p + 20, 8);
+        std::memcpy(&crc, p + 28, 4);
+    }
+};
+
+static bool readAt(int fd, uint8_t* dst, size_t len, size_t offset) {
+    while (len > 0) {
+        const ssize_t n = pread(fd, dst, len, offset);
+        if (n <= 0)
+            return false;
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+    return true;
+}
+
+DiskCache::Segment::~Segment() {
+    if (fd >= 0)
+        close(fd);
+}
+
+DiskCache::DiskCache(std::filesystem::path dir, size_t capacity, size_t segmentSize) 
+: _dir(std::move(dir)), _capacity(capacity), _segmentSize(segmentSize) {
+    std::filesystem::create_directories(_dir);
+    load();
+}
+
+DiskCache::~DiskCache() = default;
+
+std::shared_ptr<DiskCache::Segment> DiskCache::openSegment(uint64_t seq) {
+    auto seg = std::make_shared<Segment>();
+    seg->seq = seq;
+    seg->path = _dir / fmt::format("{:016x}.seg", seq);
+    seg->fd = open(seg->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (seg->fd < 0)
+        throw std::runtime_error("Failed to open cache segment " + seg->path.string());
+    return seg;
+}
+
+// starts a new active segment after the current one, call with the lock held
+std::shared_ptr<DiskCache::Segment> DiskCache::nextSegment() {
+    const uint64_t next = _segments.rbegin()->first + 1;
+    auto seg = openSegment(next);
+    _segments.emplace(next, seg);
+    return seg;
+}
+
+void DiskCache::load() {
+    std::vector<uint64_t> seqs;
+    for (const auto& entry : std::filesystem::directory_iterator(_dir)) {
+        if (entry.path().extension() != ".seg")
+            continue;
+        try {
+            seqs.push_back(std::stoull(entry.path().stem().string(), nullptr, 16));
+        } catch (const std::exception&) {}
+    }
+    std::sort(seqs.begin(), seqs.end());
+
+    for (const auto seq : seqs) {
+        auto seg = openSegment(seq);
+        scan(seg);
+        if (seg->size == 0) {
+            std::filesystem::remove(seg->path);
+            continue;
+        }
+        _segments.emplace(seq, std::move(seg));
+    }
+
+    // always append to a fresh segment so a torn tail is never written after
+    const uint64_t next = _segments.empty() ? 0 : _segments.rbegin()->first + 1;
+    _segments.emplace(next, openSegment(next));
+    evict();
+
+    std::cout << "[disk cache] loaded " << _index.size() << " entries, " << (_size >> 20) << " MB" << std::endl;
+}
+
+void DiskCache::scan(const std::shared_ptr<Segment>& seg) {
+    const auto fileSize = static_cast<size_t>(lseek(seg->fd, 0, SEEK_END));
+    size_t offset = 0;
+    std::vector<uint8_t> buf;
+
+    while (offset + RECORD_HEADER_SIZE <= fileSize) {
+        uint8_t hbuf[RECORD_HEADER_SIZE];
+        RecordHeader h;
+        if (!readAt(seg->fd, hbuf, RECORD_HEADER_SIZE, offset))
+            break;
+        h.read(hbuf);
+
+        const size_t payload = static_cast<size_t>(h.keyLen) + h.metaLen + h.bodyLen;
+        if (h.magic != RECORD_MAGIC || offset + RECORD_HEADER_SIZE + payload > fileSize)
+            break;
+
+        buf.resize(payload);
+        if (!readAt(seg->fd, buf.data(), payload, offset + RECORD_HEADER_SIZE) || crc32(0, buf.data(), payload) != h.crc)
+            break;
+
+        std::string key(reinterpret_cast<const char*>(buf.data()), h.keyLen);
+        const size_t length = RECORD_HEADER_SIZE + payload;
+
+        // the newest version wins regardless of which segment it landed in
+        auto it = _index.find(key);
+        if (it == _index.end() || it->second.version < h.version)
+            _index[key] = Loc{seg, offset, length, h.version};
+        _version = std::max(_version, h.version + 1);
+        offset += length;
+    }
+
+    // drop a torn or corrupt tail left by a crash
+    if (offset < fileSize && ftruncate(seg->fd, offset) != 0)
+        std::cerr << "[disk cache] failed to truncate " << seg->path << std::endl;
+
+    seg->size = offset;
+    _size += offset;
+}
+
+void DiskCache::evict() {
+    // drop whole segments, oldest first, never the active one
+    while (_size > _capacity && _segments.size() > 1) {
+        auto oldest = _segments.begin()->second;
+        _segments.erase(_segments.begin());
+
+        for (auto it = _index.begin(); it != _index.end();)
+            it = it->second.seg == oldest ? _index.erase(it) : std::next(it);
+
+        _size -= oldest->size;
+        std::filesystem::remove(oldest->path);
+    }
+}
+
+uint64_t DiskCache::nextVersion() {
+    std::lock_guard lock(_mtx);
+    return _version++;
+}
+
+std::shared_ptr<const CachedObject> DiskCache::get(const std::string& key) {
+    Loc loc;
+    {
+        std::lock_guard lock(_mtx);
+        const auto it = _index.find(key);
+        if (it == _index.end())
+            return nullptr;
+        loc = it->second;
+    }
+
+    // read outside the lock, the segment fd stays open while loc holds it
+    uint8_t hbuf[RECORD_HEADER_SIZE];
+    RecordHeader h;
+    if (!readAt(loc.seg->fd, hbuf, RECORD_HEADER_SIZE, loc.offset))
+        return nullptr;
+    h.read(hbuf);
+
+    const size_t payload = loc.length - RECORD_HEADER_SIZE;
+    std::vector<uint8_t> buf(payload);
+    if (!readAt(loc.seg->fd, buf.data(), payload, loc.offset + RECORD_HEADER_SIZE) || crc32(0, buf.data(), payload) != h.crc)
+        return nullptr;
+
+    auto obj = std::make_shared<CachedObject>();
+    const uint8_t* p = buf.data() + h.keyLen;
+
+    uint32_t count;
+    std::memcpy(&count, p, 4);
+    p += 4;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t klen, vlen;
+        std::memcpy(&klen, p, 4);
+        std::string k(reinterpret_cast<const char*>(p + 4), klen);
+        p += 4 + klen;
+        std::memcpy(&vlen, p, 4);
+        std::string v(reinterpret_cast<const char*>(p + 4), vlen);
+        p += 4 + vlen;
+        obj->metadata.emplace(std::move(k), std::move(v));
+    }
+
+    for (auto* field : {&obj->etag, &obj->lastModified}) {
+        uint32_t len;
+        std::memcpy(&len, p, 4);
+        field->assign(reinterpret_cast<const char*>(p + 4), len);
+        p += 4 + len;
+    }
+
+    obj->body.assign(p, p + h.bodyLen);
+    return obj;
+}
+
+void DiskCache::put(const std::string& key, const CachedObject& obj, uint64_t version) {
+    // header, key and metadata go in one small buffer, the body is written straight from obj
+    std::vector<uint8_t> head(RECORD_HEADER_SIZE + key.size() + 4);
+    std::memcpy(head.data() + RECORD_HEADER_SIZE, key.data(), key.size());
+    const uint32_t count = obj.metadata.size();
+    std::memcpy(head.data() + RECORD_HEADER_SIZE + key.size(), &count, 4);
+    const auto append = [&head](const std::string& str) {
+        const uint32_t len = str.size();
+        const size_t at = head.size();
+        head.resize(at + 4 + len);
+        std::memcpy(head.data() + at, &len, 4);
+        std::memcpy(head.data() + at + 4, str.data(), len);
+    };
+    for (const auto& [k, v] : obj.metadata) {
+        append(k);
+        append(v);
+    }
+    append(obj.etag);
+    append(obj.lastModified);
+
+    RecordHeader h;
+    h.magic = RECORD_MAGIC;
+    h.version = version;
+    h.keyLen = key.size();
+    h.metaLen = head.size() - RECORD_HEADER_SIZE - key.size();
+    h.bodyLen = obj.body.size();
+    h.crc = crc32(crc32(0, head.data() + RECORD_HEADER_SIZE, head.size() - RECORD_HEADER_SIZE), obj.body.data(), obj.body.size());
+    h.write(head.data());
+
+    const size_t length = head.size() + obj.body.size();
+
+    // reserve the space under the lock, write outside it so gets and other puts don't wait
+    // behind a large body
+    std::shared_ptr<Segment> seg;
+    size_t offset;
+    {
+        std::lock_guard lock(_mtx);
+
+        // a newer version was already written by another thread
+        const auto existing = _index.find(key);
+        if (existing != _index.end() && existing->second.version > version)
+            return;
+
+        seg = _segments.rbegin()->second;
+        if (seg->size > 0 && seg->size + length > _segmentSize)
+            seg = nextSegment();
+        offset = seg->size;
+        seg->size += length;
+        _size += length;
+        evict();
+    }
+
+    iovec iov[2] = {
+        {head.data(), head.size()},
+        {const_cast<uint8_t*>(obj.body.data()), obj.body.size()}
+    };
+    const ssize_t n = pwritev(seg->fd, iov, 2, offset);
+
+    std::lock_guard lock(_mtx);
+    if (n != static_cast<ssize_t>(length)) {
+        // the scan stops at the partial record, so later records go to a fresh segment
+        std::cerr << "[disk cache] write failed for " << key << std::endl;
+        if (_segments.rbegin()->second == seg)
+            nextSegment();
+        return;
+    }
+
+    // published unless the segment was evicted or a newer version got in while writing
+    const auto existing = _index.find(key);
+    if (!_segments.contains(seg->seq) || (existing != _index.end() && existing->second.version > version))
+        return;
+    _index[key] = Loc{seg, offset, length, version};
+}
+
+size_t DiskCache::bytes() const {
+    std::lock_guard lock(_mtx);
+    return _size;
+}
+
+size_t DiskCache::entries() const {
+    std::lock_guard lock(_mtx);
+    return _index.size();
+}
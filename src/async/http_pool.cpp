@@ -0,0 +1,283 @@
+#include <stdexcept>
+#include <algorithm>
+
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+
+#include "async/http_pool.hpp"
+#include "config/config.hpp"
+
+HttpPool::Origin HttpPool::parseOrigin(const std::string& url) {
+    // scheme://host[:port][/path], path is ignored
+    Origin o;
+    std::string rest = url;
+    if (rest.starts_with("https://"))
+        rest.erase(0, 8);
+    else if (rest.starts_with("http://")) {
+        rest.erase(0, 7);
+        o.tls = false;
+    }
+
+    rest = rest.substr(0, rest.find('/'));
+    const size_t colon = rest.rfind(':');
+    if (colon != std::string::npos) {
+        o.host = rest.substr(0, colon);
+        o.port = rest.substr(colon + 1);
+    } else {
+        o.host = rest;
+        o.port = o.tls ? "443" : "80";
+    }
+
+    if (o.host.empty())
+        throw std::invalid_argument("Invalid url " + url);
+    return o;
+}
+
+HttpPool::HttpPool(Origin origin, size_t maxIdle) 
+: _origin(std::move(origin)), _maxIdle(maxIdle), _sslCtx(asio::ssl::context::tls_client) {
+    _sslCtx.set_default_verify_paths();
+    _sslCtx.set_verify_mode(asio::ssl::verify_peer);
+}
+
+asio::awaitable<std::unique_ptr<HttpPool::Conn>> HttpPool::connect() {
+    const auto exec = co_await asio::this_coro::executor;
+    const auto timeout = std::chrono::seconds(CONFIG::HTTP_IO_TIMEOUT_SEC);
+
+    if (!_endpoints) {
+        asio::ip::tcp::resolver resolver(exec);
+        _endpoints = co_await resolver.async_resolve(_origin.host, _origin.port, asio::use_awaitable);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    auto conn = std::make_unique<Conn>();
+    if (_origin.tls) {
+        conn->tls = std::make_unique<beast::ssl_stream<beast::tcp_stream>>(exec, _sslCtx);
+        if (!SSL_set_tlsext_host_name(conn->tls->native_handle(), _origin.host.c_str()))
+            throw std::runtime_error("Failed to set SNI host name");
+        conn->tls->set_verify_callback(asio::ssl::host_name_verification(_origin.host));
+        // offer the last session so the server can skip the full handshake
+        if (_session)
+            SSL_set_session(conn->tls->native_handle(), _session.get());
+    } else
+        conn->plain = std::make_unique<beast::tcp_stream>(exec);
+
+    auto& tcp = conn->tcp();
+    tcp.expires_after(timeout);
+    try {
+        co_await tcp.async_connect(*_endpoints, asio::use_awaitable);
+    } catch (...) {
+        _endpoints.reset(); // re-resolve next time
+        _stats.failed++;
+        throw;
+    }
+    tcp.socket().set_option(asio::ip::tcp::no_delay(true));
+    tcp.socket().set_option(asio::socket_base::keep_alive(true));
+
+    if (conn->tls) {
+        tcp.expires_after(timeout);
+        try {
+            co_await conn->tls->async_handshake(asio::ssl::stream_base::client, asio::use_awaitable);
+        } catch (...) {
+            _session.reset(); // may have been rejected, fall back to a full handshake
+            _stats.failed++;
+            throw;
+        }
+        if (SSL_session_reused(conn->tls->native_handle()))
+            _stats.resumed++;
+    }
+
+    _stats.connects++;
+    _stats.connectMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    co_return conn;
+}
+
+void HttpPool::saveSession(Conn& conn) {
+    // tls 1.3 tickets arrive after the handshake, so grab the session after the first response
+    if (!conn.tls || conn.sessionSaved)
+        return;
+    conn.sessionSaved = true;
+    SSL_SESSION* session = SSL_get1_session(conn.tls->native_handle());
+    if (!session)
+        return;
+    if (SSL_SESSION_is_resumable(session))
+        _session.reset(session, SSL_SESSION_free);
+    else
+        SSL_SESSION_free(session);
+}
+
+void HttpPool::release(std::unique_ptr<Conn> conn) {
+    if (_idle.size() >= _maxIdle)
+        return;
+    conn->lastUsed = std::chrono::steady_clock::now();
+    _idle.push_back(std::move(conn));
+}
+
+// requests that can be sent twice, the server may have acted on one that failed on a stale
+// connection
+static bool idempotent(http::verb method) {
+    return method == http::verb::get || method == http::verb::head || method == http::verb::put || method == http::verb::delete_;
+}
+
+// written is set once any byte of the request went out
+template <class Stream>
+asio::awaitable<void> HttpPool::roundTrip(Stream& stream, Conn& conn, Request& req, Response& res, bool headOnly, bool& written) {
+    const auto timeout = std::chrono::seconds(CONFIG::HTTP_IO_TIMEOUT_SEC);
+
+    conn.tcp().expires_after(timeout);
+    boost::system::error_code ec;
+    written = co_await http::async_write(stream, req, asio::redirect_error(asio::use_awaitable, ec)) > 0;
+    if (ec)
+        throw boost::system::system_error(ec);
+
+    http::response_parser<http::vector_body<uint8_t>> parser;
+    parser.body_limit(static_cast<std::uint64_t>(CONFIG::HTTP_MAX_BODY_SIZE) << 20);
+    parser.skip(headOnly); // HEAD responses carry Content-Length but no body
+
+    conn.tcp().expires_after(timeout);
+    co_await http::async_read(stream, conn.buf, parser, asio::use_awaitable);
+    res = parser.release();
+}
+
+asio::awaitable<HttpPool::Result> HttpPool::send(Request& req, bool headOnly) {
+    req.version(11);
+    req.keep_alive(true);
+    req.set(http::field::host, _origin.host);
+    req.prepare_payload();
+
+    Result out;
+
+    // a reused connection may have been closed by the server while idle. in that case
+    // retry once on a fresh connection if the request is idempotent or never went out, a fresh
+    // connection failing is a real error
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::unique_ptr<Conn> conn;
+        bool reused = false;
+        bool written = false;
+        const auto now = std::chrono::steady_clock::now();
+        while (!_idle.empty() && !conn) {
+            conn = std::move(_idle.back());
+            _idle.pop_back();
+            if (now - conn->lastUsed > std::chrono::seconds(CONFIG::HTTP_IDLE_TIMEOUT_SEC))
+                conn.reset(); // likely closed by the server already
+        }
+        reused = conn != nullptr;
+
+        _active++;
+        try {
+            if (!conn)
+                conn = co_await connect();
+
+            if (conn->tls)
+                co_await roundTrip(*conn->tls, *conn, req, out.res, headOnly, written);
+            else
+                co_await roundTrip(*conn->plain, *conn, req, out.res, headOnly, written);
+        } catch (const std::exception& e) {
+            _active--;
+            if (reused && attempt == 0 && (idempotent(req.method()) || !written))
+                continue;
+            out.err = true;
+            out.errMsg = e.what();
+            co_return out;
+        }
+        _active--;
+
+        saveSession(*conn);
+        if (out.res.keep_alive())
+            release(std::move(conn));
+        co_return out;
+    }
+
+    co_return out;
+}
+
+asio::awaitable<void> HttpPool::warmOne() {
+    try {
+        auto conn = co_await connect();
+        release(std::move(conn));
+    } catch (const std::exception&) {
+        // counted in stats, the next send or keepWarm tick tries again
+    }
+    _opening--;
+}
+
+asio::awaitable<void> HttpPool::prewarm(size_t n) {
+    const auto exec = co_await asio::this_coro::executor;
+    const size_t open = _idle.size() + _active + _opening;
+    for (size_t i = open; i < std::min(n, _maxIdle); ++i) {
+        _opening++;
+        asio::co_spawn(exec, warmOne(), asio::detached);
+    }
+}
+
+asio::awaitable<bool> HttpPool::ping(Conn& conn, Request& req) {
+    req.version(11);
+    req.keep_alive(true);
+    req.set(http::field::host, _origin.host);
+    req.prepare_payload();
+
+    Response res;
+    bool written = false;
+    try {
+        if (conn.tls)
+            co_await roundTrip(*conn.tls, conn, req, res, req.method() == http::verb::head, written);
+        else
+            co_await roundTrip(*conn.plain, conn, req, res, req.method() == http::verb::head, written);
+    } catch (const std::exception&) {
+        co_return false;
+    }
+    _stats.pings++;
+    saveSession(conn);
+    co_return res.keep_alive(); // any status will do, the point is the round trip
+}
+
+asio::awaitable<void> HttpPool::keepWarm(size_t warm, std::function<Request()> makePing, const std::atomic<bool>& stop) {
+    const auto exec = co_await asio::this_coro::executor;
+    asio::steady_timer timer(exec);
+    const auto interval = std::chrono::seconds(CONFIG::HTTP_KEEPALIVE_SEC);
+
+    co_await prewarm(warm);
+
+    // tick every second so shutdown isn't held up by a long timer
+    for (int64_t tick = 1;; ++tick) {
+        timer.expires_after(std::chrono::seconds(1));
+        co_await timer.async_wait(asio::use_awaitable);
+        if (stop.load(std::memory_order_relaxed))
+            break;
+        if (tick % CONFIG::HTTP_KEEPALIVE_SEC != 0)
+            continue;
+
+        // ping the oldest idle connections that haven't been used for a while, up to the warm
+        // count. the rest expire on their own
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<std::unique_ptr<Conn>> stale;
+        while (!_idle.empty() && stale.size() < warm && now - _idle.front()->lastUsed >= interval) {
+            stale.push_back(std::move(_idle.front()));
+            _idle.pop_front();
+        }
+        for (auto& conn : stale) {
+            if (now - conn->lastUsed > std::chrono::seconds(CONFIG::HTTP_IDLE_TIMEOUT_SEC))
+                continue; // likely closed by the server already
+            auto req = makePing();
+            if (co_await ping(*conn, req))
+                release(std::move(conn));
+        }
+
+        // reopen whatever was lost while quiet
+        co_await prewarm(warm);
+    }
+}
+
+HttpPool::Stats HttpPool::stats() const {
+    auto stats = _stats;
+    stats.idle = _idle.size();
+    stats.active = _active;
+    return stats;
+}
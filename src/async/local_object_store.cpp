@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+#include <ctime>
+#include <system_error>
+
+#include <openssl/evp.h>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <nlohmann/json.hpp>
+#include <fmt/format.h>
+
+#include "async/local_object_store.hpp"
+
+namespace fs = std::filesystem;
+
+static constexpr auto META_SUFFIX = ".meta";
+
+// quoted md5 hex like R2 uses for single part uploads
+static std::string etagOf(const std::vector<uint8_t>& data) {
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    EVP_Digest(data.data(), data.size(), hash, &len, EVP_md5(), nullptr);
+    std::string out = "\"";
+    for (unsigned int i = 0; i < len; ++i)
+        out += fmt::format("{:02x}", hash[i]);
+    return out + "\"";
+}
+
+static std::string httpDate() {
+    const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm tm;
+    gmtime_r(&now, &tm);
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+// write to a temp file and rename over the target so readers never see a partial file
+static void writeAtomic(const fs::path& path, const fs::path& tmp, const char* data, size_t size) {
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.write(data, size))
+            throw std::runtime_error("Failed to write " + tmp.string());
+    }
+    fs::rename(tmp, path);
+}
+
+template<typename Outcome>
+static Outcome localError(Aws::S3::S3Errors type, const std::string& msg) {
+    Outcome out;
+    out.err = true;
+    out.errType = type;
+    out.errMsg = "Local store error: " + msg;
+    return out;
+}
+
+LocalObjectStore::LocalObjectStore(const std::string& root, int64_t latencyMs, double bandwidthMBps, size_t threads)
+: _root(root), _latencyMs(latencyMs), _bandwidthMBps(bandwidthMBps), _threadPool(threads) {
+    fs::create_directories(_root);
+}
+
+LocalObjectStore::~LocalObjectStore() {
+    _threadPool.join();
+}
+
+fs::path LocalObjectStore::pathFor(const std::string& bucket, const std::string& key) const {
+    return _root / bucket / key;
+}
+
+asio::awaitable<void> LocalObjectStore::delay(size_t bytes) {
+    double ms = static_cast<double>(_latencyMs);
+    if (_bandwidthMBps > 0)
+        ms += static_cast<double>(bytes) / (_bandwidthMBps * (1 << 20)) * 1000.0;
+    if (ms <= 0)
+        co_return;
+
+    asio::steady_timer timer(co_await asio::this_coro::executor);
+    timer.expires_after(std::chrono::duration_cast<asio::steady_timer::duration>(std::chrono::duration<double, std::milli>(ms)));
+    co_await timer.async_wait(asio::use_awaitable);
+}
+
+asio::awaitable<ObjectStore::GetOutcome> LocalObjectStore::get(
+    const std::string& bucket,
+    const std::string& key,
+    const std::string& ifNoneMatch
+) {
+    auto read = [path = pathFor(bucket, key), ifNoneMatch]() -> asio::awaitable<GetOutcome> {
+        try {
+            std::ifstream metaFile(path.string() + META_SUFFIX);
+            std::ifstream file(path, std::ios::binary);
+            if (!metaFile || !file)
+                co_return localError<GetOutcome>(Aws::S3::S3Errors::NO_SUCH_KEY, "no such key " + path.string());
+
+            const auto meta = nlohmann::json::parse(metaFile);
+            GetOutcome out;
+            if (!ifNoneMatch.empty() && meta.value("etag", "") == ifNoneMatch) {
+                out.notModified = true;
+                co_return out;
+            }
+
+            auto cached = std::make_shared<CachedObject>();
+            cached->body.resize(fs::file_size(path));
+            if (!file.read(reinterpret_cast<char*>(cached->body.data()), cached->body.size()))
+                co_return localError<GetOutcome>(Aws::S3::S3Errors::UNKNOWN, "short read of " + path.string());
+            cached->metadata = meta.value("metadata", std::unordered_map<std::string, std::string>{});
+            cached->etag = meta.value("etag", "");
+            cached->lastModified = meta.value("lastModified", "");
+            co_return GetOutcome::fromObject(std::move(cached));
+        } catch (const std::exception& e) {
+            co_return localError<GetOutcome>(Aws::S3::S3Errors::UNKNOWN, e.what());
+        }
+    };
+    auto obj = co_await asio::co_spawn(_threadPool.get_executor(), std::move(read), asio::use_awaitable);
+
+    co_await delay(obj.body.size());
+    co_return obj;
+}
+
+asio::awaitable<ObjectStore::GetOutcome> LocalObjectStore::head(const std::string& bucket, const std::string& key) {
+    auto read = [path = pathFor(bucket, key)]() -> asio::awaitable<GetOutcome> {
+        try {
+            std::ifstream metaFile(path.string() + META_SUFFIX);
+            if (!metaFile)
+                co_return localError<GetOutcome>(Aws::S3::S3Errors::NO_SUCH_KEY, "no such key " + path.string());
+
+            const auto meta = nlohmann::json::parse(metaFile);
+            GetOutcome out;
+            out.metadata = meta.value("metadata", std::unordered_map<std::string, std::string>{});
+            out.etag = meta.value("etag", "");
+            out.lastModified = meta.value("lastModified", "");
+            co_return out;
+        } catch (const std::exception& e) {
+            co_return localError<GetOutcome>(Aws::S3::S3Errors::UNKNOWN, e.what());
+        }
+    };
+    auto obj = co_await asio::co_spawn(_threadPool.get_executor(), std::move(read), asio::use_awaitable);
+
+    co_await delay(0);
+    co_return obj;
+}
+
+asio::awaitable<ObjectStore::GetOutcome> LocalObjectStore::getRange(
+    const std::string& bucket,
+    const std::string& key,
+    uint64_t offset,
+    uint64_t length
+) {
+    auto read = [path = pathFor(bucket, key), offset, length]() -> asio::awaitable<GetOutcome> {
+        try {
+            std::ifstream metaFile(path.string() + META_SUFFIX);
+            std::ifstream file(path, std::ios::binary);
+            if (!metaFile || !file)
+                co_return localError<GetOutcome>(Aws::S3::S3Errors::NO_SUCH_KEY, "no such key " + path.string());
+
+            const uint64_t size = fs::file_size(path);
+            if (offset >= size)
+                co_return localError<GetOutcome>(Aws::S3::S3Errors::UNKNOWN, fmt::format("range {} past the end of {}", offset, path.string()));
+
+            const auto meta = nlohmann::json::parse(metaFile);
+            auto part = std::make_shared<CachedObject>();
+            part->body.resize(std::min(length, size - offset));
+            file.seekg(static_cast<std::streamoff>(offset));
+            if (!file.read(reinterpret_cast<char*>(part->body.data()), part->body.size()))
+                co_return localError<GetOutcome>(Aws::S3::S3Errors::UNKNOWN, "short read of " + path.string());
+            part->etag = meta.value("etag", "");
+            part->lastModified = meta.value("lastModified", "");
+            co_return GetOutcome::fromObject(std::move(part));
+        } catch (const std::exception& e) {
+            co_return localError<GetOutcome>(Aws::S3::S3Errors::UNKNOWN, e.what());
+        }
+    };
+    auto obj = co_await asio::co_spawn(_threadPool.get_executor(), std::move(read), asio::use_awaitable);
+
+    co_await delay(obj.body.size());
+    co_return obj;
+}
+
+asio::awaitable<ObjectStore::PutOutcome> LocalObjectStore::put(
+    const std::string& bucket,
+    const std::string& key,
+    const std::string& contentType,
+    std::shared_ptr<const std::vector<uint8_t>> data
+) {
+    // the upload happens before the object becomes visible
+    co_await delay(data->size());
+
+    const uint64_t seq = _tmpSeq.fetch_add(1, std::memory_order_relaxed);
+    auto write = [path = pathFor(bucket, key), contentType, data, seq]() -> asio::awaitable<PutOutcome> {
+        try {
+            fs::create_directories(path.parent_path());
+            const std::string tmp = fmt::format("{}.tmp{}", path.string(), seq);
+
+            PutOutcome out;
+            out.etag = etagOf(*data);
+            const std::string meta = nlohmann::json{
+                {"contentType", contentType},
+                {"etag", out.etag},
+                {"lastModified", httpDate()},
+                {"metadata", nlohmann::json::object()}
+            }.dump();
+
+            // body first: a reader racing the sidecar sees the new body with the old etag,
+            // which at worst costs it one extra transfer on revalidation
+            writeAtomic(path, tmp, reinterpret_cast<const char*>(data->data()), data->size());
+            writeAtomic(path.string() + META_SUFFIX, tmp, meta.data(), meta.size());
+            co_return out;
+        } catch (const std::exception& e) {
+            co_return localError<PutOutcome>(Aws::S3::S3Errors::UNKNOWN, e.what());
+        }
+    };
+    co_return co_await asio::co_spawn(_threadPool.get_executor(), std::move(write), asio::use_awaitable);
+}
@@ -0,0 +1,252 @@
+#include <functional>
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include "async/object_cache.hpp"
+
+static constexpr size_t WINDOW_PERCENT = 1;
+static constexpr size_t SKETCH_WIDTH = 1 << 14; // counters per row
+static constexpr size_t SKETCH_ROWS = 4;
+static constexpr size_t SKETCH_RESET = SKETCH_WIDTH * 10; // halve all counters after this many increments
+static constexpr uint8_t SKETCH_MAX = 15;
+static constexpr uint64_t SKETCH_SEEDS[SKETCH_ROWS] = {
+    0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull
+};
+
+ObjectCache::FrequencySketch::FrequencySketch() : _table(SKETCH_WIDTH * SKETCH_ROWS, 0) {}
+
+size_t ObjectCache::FrequencySketch::index(uint64_t hash, size_t row) const {
+    constexpr int shift = 64 - std::countr_zero(SKETCH_WIDTH);
+    return row * SKETCH_WIDTH + ((hash * SKETCH_SEEDS[row]) >> shift);
+}
+
+void ObjectCache::FrequencySketch::increment(uint64_t hash) {
+    for (size_t row = 0; row < SKETCH_ROWS; ++row) {
+        auto& c = _table[index(hash, row)];
+        if (c < SKETCH_MAX)
+            ++c;
+    }
+
+    if (++_additions >= SKETCH_RESET) {
+        for (auto& c : _table)
+            c >>= 1;
+        _additions /= 2;
+    }
+}
+
+uint8_t ObjectCache::FrequencySketch::frequency(uint64_t hash) const {
+    uint8_t freq = SKETCH_MAX;
+    for (size_t row = 0; row < SKETCH_ROWS; ++row)
+        freq = std::min(freq, _table[index(hash, row)]);
+    return freq;
+}
+
+ObjectCache::Pin::Pin(ObjectCache* cache, std::string key) : _cache(cache), _key(std::move(key)) {
+    if (_cache)
+        _cache->pin(_key);
+}
+
+ObjectCache::Pin::Pin(Pin&& other) noexcept : _cache(std::exchange(other._cache, nullptr)), _key(std::move(other._key)) {}
+
+ObjectCache::Pin& ObjectCache::Pin::operator=(Pin&& other) noexcept {
+    if (this != &other) {
+        if (_cache)
+            _cache->unpin(_key);
+        _cache = std::exchange(other._cache, nullptr);
+        _key = std::move(other._key);
+    }
+    return *this;
+}
+
+ObjectCache::Pin::~Pin() {
+    if (_cache)
+        _cache->unpin(_key);
+}
+
+ObjectCache::ObjectCache(size_t capacity, size_t shardCount) : _shards(std::max<size_t>(1, shardCount)) {
+    const size_t shardCapacity = capacity / _shards.size();
+    _windowCapacity = shardCapacity * WINDOW_PERCENT / 100;
+    _mainCapacity = shardCapacity - _windowCapacity;
+}
+
+ObjectCache::Shard& ObjectCache::shardFor(const std::string& key) {
+    return _shards[std::hash<std::string>{}(key) % _shards.size()];
+}
+
+size_t ObjectCache::entrySize(const std::string& key, const CachedObject& obj) {
+    // key is stored twice (map + lru), plus node and control block overhead
+    size_t size = sizeof(CachedObject) + 2 * (key.size() + sizeof(std::string)) + 64;
+    size += obj.body.capacity();
+    for (const auto& [k, v] : obj.metadata)
+        size += k.size() + v.size() + 2 * sizeof(std::string);
+    return size;
+}
+
+std::string ObjectCache::layerOf(const std::string& key) {
+    // keys are chunk ids, "l<layer>_<id>" for low res chunks and "<x>_<y>" for base chunks
+    if (!key.empty() && key[0] == 'l')
+        return key.substr(0, key.find('_'));
+    return "base";
+}
+
+void ObjectCache::remove(Shard& shard, std::unordered_map<std::string, Entry>::iterator it) {
+    auto& c = shard.counters[layerOf(it->first)];
+    c.entries--;
+    c.bytes -= it->second.size;
+
+    if (it->second.inWindow) {
+        shard.windowSize -= it->second.size;
+        shard.window.erase(it->second.it);
+    } else {
+        shard.mainSize -= it->second.size;
+        shard.main.erase(it->second.it);
+    }
+    shard.map.erase(it);
+}
+
+std::shared_ptr<const CachedObject> ObjectCache::get(const std::string& key) {
+    auto& shard = shardFor(key);
+    const uint64_t hash = std::hash<std::string>{}(key);
+    std::lock_guard lock(shard.mtx);
+
+    shard.sketch.increment(hash);
+
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        shard.counters[layerOf(key)].misses++;
+        return nullptr;
+    }
+
+    shard.counters[layerOf(key)].hits++;
+    auto& list = it->second.inWindow ? shard.window : shard.main;
+    list.splice(list.begin(), list, it->second.it); // move to front
+    return it->second.obj;
+}
+
+void ObjectCache::put(const std::string& key, std::shared_ptr<const CachedObject> obj) {
+    auto& shard = shardFor(key);
+    const size_t size = entrySize(key, *obj);
+    const uint64_t hash = std::hash<std::string>{}(key);
+    std::lock_guard lock(shard.mtx);
+
+    shard.sketch.increment(hash);
+
+    // drop any previous version first so a stale copy is never served
+    if (auto it = shard.map.find(key); it != shard.map.end())
+        remove(shard, it);
+
+    shard.window.push_front(key);
+    shard.map.emplace(key, Entry{std::move(obj), size, true, shard.window.begin()});
+    shard.windowSize += size;
+
+    auto& c = shard.counters[layerOf(key)];
+    c.entries++;
+    c.bytes += size;
+
+    drainWindow(shard);
+}
+
+void ObjectCache::drainWindow(Shard& shard) {
+    while (shard.windowSize > _windowCapacity && !shard.window.empty())
+        admit(shard, shard.window.back());
+}
+
+void ObjectCache::admit(Shard& shard, const std::string& candidate) {
+    // copy, the list node holding the key is moved or erased below
+    const std::string key = candidate;
+    auto it = shard.map.find(key);
+    const bool pinned = shard.pins.contains(key);
+    const uint8_t freq = shard.sketch.frequency(std::hash<std::string>{}(key));
+
+    // make room in main, the candidate has to beat each victim it displaces
+    while (shard.mainSize + it->second.size > _mainCapacity) {
+        const auto victim = lastUnpinned(shard);
+        if (victim == shard.main.rend() || (!pinned && freq <= shard.sketch.frequency(std::hash<std::string>{}(*victim)))) {
+            if (pinned)
+                break; // pinned entries may run over budget until unpinned
+            shard.counters[layerOf(key)].rejects++;
+            remove(shard, it);
+            return;
+        }
+
+        shard.counters[layerOf(*victim)].evictions++;
+        remove(shard, shard.map.find(*victim));
+    }
+
+    shard.windowSize -= it->second.size;
+    shard.mainSize += it->second.size;
+    shard.main.splice(shard.main.begin(), shard.window, it->second.it);
+    it->second.inWindow = false;
+}
+
+std::list<std::string>::reverse_iterator ObjectCache::lastUnpinned(Shard& shard) {
+    auto victim = shard.main.rbegin();
+    while (victim != shard.main.rend() && shard.pins.contains(*victim))
+        ++victim;
+    return victim;
+}
+
+void ObjectCache::trimMain(Shard& shard) {
+    while (shard.mainSize > _mainCapacity) {
+        const auto victim = lastUnpinned(shard);
+        if (victim == shard.main.rend())
+            break;
+        shard.counters[layerOf(*victim)].evictions++;
+        remove(shard, shard.map.find(*victim));
+    }
+}
+
+void ObjectCache::erase(const std::string& key) {
+    auto& shard = shardFor(key);
+    std::lock_guard lock(shard.mtx);
+
+    auto it = shard.map.find(key);
+    if (it != shard.map.end())
+        remove(shard, it);
+}
+
+void ObjectCache::pin(const std::string& key) {
+    auto& shard = shardFor(key);
+    std::lock_guard lock(shard.mtx);
+    shard.pins[key]++;
+}
+
+void ObjectCache::unpin(const std::string& key) {
+    auto& shard = shardFor(key);
+    std::lock_guard lock(shard.mtx);
+
+    auto it = shard.pins.find(key);
+    if (it == shard.pins.end() || --it->second > 0)
+        return;
+    shard.pins.erase(it);
+
+    // pinned entries may have pushed main over budget
+    trimMain(shard);
+}
+
+size_t ObjectCache::bytes() const {
+    size_t total = 0;
+    for (const auto& shard : _shards) {
+        std::lock_guard lock(shard.mtx);
+        total += shard.windowSize + shard.mainSize;
+    }
+    return total;
+}
+
+std::map<std::string, ObjectCache::Counters> ObjectCache::stats() const {
+    std::map<std::string, Counters> out;
+    for (const auto& shard : _shards) {
+        std::lock_guard lock(shard.mtx);
+        for (const auto& [layer, c] : shard.counters) {
+            auto& o = out[layer];
+            o.hits += c.hits;
+            o.misses += c.misses;
+            o.evictions += c.evictions;
+            o.rejects += c.rejects;
+            o.entries += c.entries;
+            o.bytes += c.bytes;
+        }
+    }
+    return out;
+}
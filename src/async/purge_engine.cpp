@@ -0,0 +1,117 @@
+#include <iostream>
+#include <algorithm>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+
+#include "async/purge_engine.hpp"
+#include "config/config.hpp"
+
+PurgeEngine::PurgeEngine(const asio::any_io_executor& exec, std::shared_ptr<CFAsyncClient> cfCli, std::string urlPrefix)
+: _cfCli(std::move(cfCli)), _urlPrefix(std::move(urlPrefix)), _wake(exec) {}
+
+void PurgeEngine::push(const std::string& path) {
+    if (!_queue.push(_urlPrefix + path)) {
+        _coalesced++;
+        return;
+    }
+    _wake.cancel();
+}
+
+asio::awaitable<void> PurgeEngine::run() {
+    const auto exec = co_await asio::this_coro::executor;
+    _running = true;
+
+    for (;;) {
+        if (_stopping && _queue.empty() && _inFlight == 0)
+            break;
+
+        const auto now = clock::now();
+        const bool paced = now < _pausedUntil || now < _nextSend;
+        if (!_queue.empty() && !paced && _inFlight < static_cast<size_t>(_window)) {
+            std::vector<std::string> batch;
+            const size_t n = std::min(_queue.size(), VARS::PURGE_URLS_LIMIT);
+            batch.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                batch.push_back(_queue.front());
+                _queue.pop();
+            }
+
+            _inFlight++;
+            _nextSend = now + std::chrono::milliseconds(CONFIG::PURGE_MIN_INTERVAL_MS);
+            asio::co_spawn(exec, sendBatch(std::move(batch)), asio::detached);
+            continue;
+        }
+
+        // sleep until pacing allows the next batch, or until pushed / a batch completes
+        _wake.expires_at(_queue.empty() || !paced ? clock::now() + std::chrono::seconds(1) : std::max(_pausedUntil, _nextSend));
+        boost::system::error_code ec;
+        co_await _wake.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+
+    _running = false;
+    co_return;
+}
+
+asio::awaitable<void> PurgeEngine::sendBatch(std::vector<std::string> urls) {
+    CFAsyncClient::PurgeOutcome out;
+    try {
+        out = co_await _cfCli->purgeCache(urls);
+    } catch (const std::exception& e) {
+        out.err = true;
+        out.errMsg = e.what();
+    }
+    _inFlight--;
+
+    if (!out.err) {
+        _purged += urls.size();
+        for (const auto& url : urls)
+            _attempts.erase(url);
+        // additive increase, roughly one extra batch per window of successes
+        _window = std::min(static_cast<double>(CONFIG::PURGE_MAX_IN_FLIGHT), _window + 1.0 / _window);
+    } else {
+        _failedBatches++;
+        std::cerr << "[purge] " << out.errMsg << std::endl;
+
+        if (out.throttled) {
+            _throttled++;
+            _window = std::max(1.0, _window / 2);
+            const auto pause = out.retryAfter.count() > 0 ? out.retryAfter : std::chrono::milliseconds(CONFIG::PURGE_BACKOFF_MS);
+            _pausedUntil = std::max(_pausedUntil, clock::now() + pause);
+        }
+
+        for (const auto& url : urls) {
+            if (++_attempts[url] >= CONFIG::PURGE_MAX_ATTEMPTS) {
+                std::cerr << "[purge] giving up on " << url << std::endl;
+                _attempts.erase(url);
+                _dropped++;
+                continue;
+            }
+            // pushed again while in flight, the queued purge covers it
+            if (_queue.push(url))
+                _retried++;
+        }
+    }
+
+    _wake.cancel();
+    co_return;
+}
+
+asio::awaitable<void> PurgeEngine::drain() {
+    const auto exec = co_await asio::this_coro::executor;
+    asio::steady_timer timer(exec);
+
+    _stopping = true;
+    _wake.cancel();
+    while (_running) {
+        timer.expires_after(std::chrono::milliseconds(100));
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+}
+
+PurgeEngine::Stats PurgeEngine::stats() const {
+    return {_queue.size(), _inFlight, _window, _purged, _failedBatches, _retried, _dropped, _throttled, _coalesced};
+}
@@ -0,0 +1,87 @@
+#include <utility>
+#include <algorithm>
+
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+
+#include "async/request_scheduler.hpp"
+
+RequestScheduler::Slot& RequestScheduler::Slot::operator=(Slot&& other) noexcept {
+    if (this != &other) {
+        if (_scheduler)
+            _scheduler->release();
+        _scheduler = std::exchange(other._scheduler, nullptr);
+    }
+    return *this;
+}
+
+RequestScheduler::Slot::~Slot() {
+    if (_scheduler)
+        _scheduler->release();
+}
+
+RequestScheduler::RequestScheduler(size_t limit) : _limit(std::max<size_t>(1, limit)) {}
+
+asio::awaitable<RequestScheduler::Slot> RequestScheduler::acquire(uint64_t job, Priority priority) {
+    bool queued = false;
+    for (const auto& c : _classes)
+        queued |= c.queued > 0;
+
+    // fast path, nobody is waiting
+    if (!queued && _inFlight < _limit) {
+        _inFlight++;
+        co_return Slot(this);
+    }
+
+    auto& c = _classes[static_cast<size_t>(priority)];
+    auto waiter = std::make_shared<Waiter>(co_await asio::this_coro::executor);
+    auto& q = c.jobs[job];
+    if (q.empty())
+        c.turns.push_back(job);
+    q.push_back(waiter);
+    c.queued++;
+
+    // release() hands the slot over directly, _inFlight already counts it
+    while (!waiter->granted) {
+        boost::system::error_code ec;
+        co_await waiter->wake.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    }
+    co_return Slot(this);
+}
+
+void RequestScheduler::release() {
+    _inFlight--;
+
+    for (auto& c : _classes) {
+        if (c.turns.empty())
+            continue;
+
+        const uint64_t job = c.turns.front();
+        c.turns.pop_front();
+        auto it = c.jobs.find(job);
+        auto waiter = std::move(it->second.front());
+        it->second.pop_front();
+
+        // back of the line for this job's next request
+        if (it->second.empty())
+            c.jobs.erase(it);
+        else
+            c.turns.push_back(job);
+        c.queued--;
+
+        _inFlight++;
+        waiter->granted = true;
+        waiter->wake.cancel();
+        return;
+    }
+}
+
+RequestScheduler::Stats RequestScheduler::stats() const {
+    Stats s{_inFlight, {}, {}};
+    for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+        s.queued[i] = _classes[i].queued;
+        s.jobs[i] = _classes[i].jobs.size();
+    }
+    return s;
+}
@@ -0,0 +1,178 @@
+#include <array>
+#include <chrono>
+#include <cctype>
+#include <ctime>
+
+#include <openssl/sha.h>
+#include <openssl/hmac.h>
+#include <openssl/evp.h>
+#include <boost/beast/http.hpp>
+#include <fmt/format.h>
+
+#include "async/s3_http_client.hpp"
+
+static constexpr auto S3_REGION = "auto";
+static constexpr auto S3_SERVICE = "s3";
+static constexpr auto UNSIGNED_PAYLOAD = "UNSIGNED-PAYLOAD";
+static constexpr std::string_view META_PREFIX = "x-amz-meta-";
+
+static std::string toHex(const unsigned char* data, size_t len) {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string out(len * 2, '\0');
+    for (size_t i = 0; i < len; ++i) {
+        out[2*i] = digits[data[i] >> 4];
+        out[2*i + 1] = digits[data[i] & 0xF];
+    }
+    return out;
+}
+
+static std::string sha256Hex(std::string_view data) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), hash);
+    return toHex(hash, SHA256_DIGEST_LENGTH);
+}
+
+static std::string hmac(std::string_view key, std::string_view data) {
+    unsigned char out[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    HMAC(
+        EVP_sha256(), 
+        key.data(), static_cast<int>(key.size()),
+        reinterpret_cast<const unsigned char*>(data.data()), data.size(),
+        out, &len
+    );
+    return std::string(reinterpret_cast<const char*>(out), len);
+}
+
+// RFC 3986 encoding as required by SigV4, '/' is kept for object keys
+static std::string uriEncode(std::string_view s, bool keepSlash) {
+    std::string out;
+    out.reserve(s.size());
+    for (const unsigned char c : s) {
+        if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~' || (keepSlash && c == '/'))
+            out.push_back(c);
+        else
+            out += fmt::format("%{:02X}", c);
+    }
+    return out;
+}
+
+S3HttpClient::S3HttpClient(
+    const std::string& endPoint,
+    const std::string& accessKey,
+    const std::string& secretKey,
+    size_t maxIdleConnections
+) : _pool(HttpPool::parseOrigin(endPoint), maxIdleConnections), _accessKey(accessKey), _secretKey(secretKey) {}
+
+void S3HttpClient::sign(HttpPool::Request& req, const std::string& canonicalUri) {
+    const std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::tm tm;
+    gmtime_r(&now, &tm);
+    char amzDate[17], dateStamp[9];
+    std::strftime(amzDate, sizeof(amzDate), "%Y%m%dT%H%M%SZ", &tm);
+    std::strftime(dateStamp, sizeof(dateStamp), "%Y%m%d", &tm);
+
+    // derived signing key only changes once a day
+    if (_signingDate != dateStamp) {
+        const auto kDate = hmac("AWS4" + _secretKey, dateStamp);
+        const auto kRegion = hmac(kDate, S3_REGION);
+        const auto kService = hmac(kRegion, S3_SERVICE);
+        _signingKey = hmac(kService, "aws4_request");
+        _signingDate = dateStamp;
+    }
+
+    const auto& host = _pool.origin().host;
+    req.set(http::field::host, host);
+    req.set("x-amz-content-sha256", UNSIGNED_PAYLOAD);
+    req.set("x-amz-date", amzDate);
+
+    static constexpr auto signedHeaders = "host;x-amz-content-sha256;x-amz-date";
+    const std::string canonicalRequest = fmt::format(
+        "{}\n{}\n\nhost:{}\nx-amz-content-sha256:{}\nx-amz-date:{}\n\n{}\n{}",
+        std::string(req.method_string()), canonicalUri, 
+        host, UNSIGNED_PAYLOAD, amzDate, 
+        signedHeaders, UNSIGNED_PAYLOAD
+    );
+
+    const std::string scope = fmt::format("{}/{}/{}/aws4_request", dateStamp, S3_REGION, S3_SERVICE);
+    const std::string stringToSign = fmt::format(
+        "AWS4-HMAC-SHA256\n{}\n{}\n{}", 
+        amzDate, scope, sha256Hex(canonicalRequest)
+    );
+    const auto sig = hmac(_signingKey, stringToSign);
+
+    req.set(http::field::authorization, fmt::format(
+        "AWS4-HMAC-SHA256 Credential={}/{}, SignedHeaders={}, Signature={}",
+        _accessKey, scope, signedHeaders, 
+        toHex(reinterpret_cast<const unsigned char*>(sig.data()), sig.size())
+    ));
+}
+
+asio::awaitable<S3HttpClient::Result> S3HttpClient::send(HttpPool::Request& req, bool headOnly) {
+    auto sent = co_await _pool.send(req, headOnly);
+
+    Result out;
+    if (sent.err) {
+        out.err = true;
+        out.errMsg = std::move(sent.errMsg);
+        co_return out;
+    }
+
+    auto& res = sent.res;
+    out.status = res.result_int();
+    out.etag = std::string(res[http::field::etag]);
+    out.lastModified = std::string(res[http::field::last_modified]);
+    for (const auto& field : res) {
+        std::string name(field.name_string());
+        for (auto& c : name)
+            c = std::tolower(static_cast<unsigned char>(c));
+        if (name.starts_with(META_PREFIX))
+            out.metadata.emplace(name.substr(META_PREFIX.size()), std::string(field.value()));
+    }
+    out.body = std::move(res.body());
+    co_return out;
+}
+
+asio::awaitable<S3HttpClient::Result> S3HttpClient::getObject(
+    const std::string& bucket, 
+    const std::string& key, 
+    bool headOnly,
+    const std::string& ifNoneMatch,
+    const std::string& range
+) {
+    // path style addressing: /bucket/key
+    const std::string uri = "/" + uriEncode(bucket, false) + "/" + uriEncode(key, true);
+
+    HttpPool::Request req{headOnly ? http::verb::head : http::verb::get, uri, 11};
+    if (!ifNoneMatch.empty())
+        req.set(http::field::if_none_match, ifNoneMatch);
+    if (!range.empty())
+        req.set(http::field::range, range);
+    sign(req, uri);
+    co_return co_await send(req, headOnly);
+}
+
+asio::awaitable<S3HttpClient::Result> S3HttpClient::putObject(
+    const std::string& bucket, 
+    const std::string& key, 
+    const std::string& contentType,
+    std::span<const uint8_t> data
+) {
+    const std::string uri = "/" + uriEncode(bucket, false) + "/" + uriEncode(key, true);
+
+    HttpPool::Request req{http::verb::put, uri, 11};
+    req.set(http::field::content_type, contentType);
+    req.body() = {data.data(), data.size()};
+    sign(req, uri);
+    co_return co_await send(req, false);
+}
+
+asio::awaitable<void> S3HttpClient::keepWarm(const std::string& bucket, size_t warm, const std::atomic<bool>& stop) {
+    // a missing key is as cheap as it gets, the 404 still keeps the connection alive
+    const std::string uri = "/" + uriEncode(bucket, false) + "/.warm";
+    co_await _pool.keepWarm(warm, [this, uri]() {
+        HttpPool::Request req{http::verb::head, uri, 11};
+        sign(req, uri);
+        return req;
+    }, stop);
+}
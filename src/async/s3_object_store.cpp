@@ -0,0 +1,390 @@
+#include <memory>
+#include <vector>
+#include <string>
+#include <streambuf>
+#include <chrono>
+
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <aws/core/Aws.h>
+#include <aws/core/auth/AWSCredentials.h>
+#include <aws/core/client/DefaultRetryStrategy.h>
+#include <aws/core/http/HttpResponse.h>
+#include <aws/core/utils/DateTime.h>
+#include <aws/core/utils/stream/PreallocatedStreamBuf.h>
+#include <aws/s3/model/HeadObjectRequest.h>
+#include <aws/s3/model/HeadObjectResult.h>
+#include <aws/s3/model/GetObjectRequest.h>
+#include <aws/s3/model/PutObjectRequest.h>
+#include <aws/s3/model/GetObjectResult.h>
+#include <aws/s3/model/PutObjectResult.h>
+#include <fmt/format.h>
+
+#include "async/s3_object_store.hpp"
+#include "config/config.hpp"
+
+// map native client results onto the sdk error types callers already check
+static Aws::S3::S3Errors httpErrorType(const S3HttpClient::Result& res) {
+    if (res.err)
+        return Aws::S3::S3Errors::NETWORK_CONNECTION;
+    switch (res.status) {
+        case 404: return Aws::S3::S3Errors::NO_SUCH_KEY;
+        case 403: return Aws::S3::S3Errors::ACCESS_DENIED;
+        case 429: return Aws::S3::S3Errors::THROTTLING;
+        case 503: return Aws::S3::S3Errors::SLOW_DOWN;
+        default: return res.status >= 500 ? Aws::S3::S3Errors::INTERNAL_FAILURE : Aws::S3::S3Errors::UNKNOWN;
+    }
+}
+
+static bool httpRetryable(const S3HttpClient::Result& res) {
+    return res.err || res.status == 429 || res.status >= 500;
+}
+
+static std::string httpErrorMsg(const S3HttpClient::Result& res) {
+    if (res.err)
+        return res.errMsg;
+    return fmt::format("status {}: {}", res.status, std::string(res.body.begin(), res.body.end()));
+}
+
+// response sink for sdk GETs. the body is written straight into a vector reserved from
+// Content-Length instead of the sdk's default stringstream and a second copy out of it
+class VectorStreamBuf : public std::streambuf {
+
+public:
+    std::vector<uint8_t> data;
+
+protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        data.insert(data.end(), reinterpret_cast<const uint8_t*>(s), reinterpret_cast<const uint8_t*>(s) + n);
+        return n;
+    }
+
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+            data.push_back(static_cast<uint8_t>(ch));
+        return ch;
+    }
+
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        // only tellp is supported
+        if (off == 0 && dir == std::ios_base::cur && (which & std::ios_base::out))
+            return pos_type(static_cast<off_type>(data.size()));
+        return pos_type(off_type(-1));
+    }
+
+};
+
+S3SdkObjectStore::S3SdkObjectStore(
+    const std::string& endPoint,
+    const std::string& accessKey,
+    const std::string& secretKey,
+    size_t concurrency
+) : _threadPool(concurrency) {
+    Aws::Client::ClientConfiguration config;
+    config.region = "auto";
+    config.endpointOverride = endPoint;
+    config.scheme = Aws::Http::Scheme::HTTPS;
+    config.maxConnections = concurrency;
+    config.enableTcpKeepAlive = true;
+    // retries and deadlines are handled by the client, each sdk call is a single attempt
+    config.retryStrategy = Aws::MakeShared<Aws::Client::DefaultRetryStrategy>("R2RetryStrategy", 0);
+    config.connectTimeoutMs = CONFIG::R2_ATTEMPT_TIMEOUT_MS;
+    config.requestTimeoutMs = CONFIG::R2_ATTEMPT_TIMEOUT_MS;
+
+    Aws::Auth::AWSCredentials creds(accessKey, secretKey);
+
+    _s3Cli = std::make_shared<Aws::S3::S3Client>(
+        creds,
+        config,
+        Aws::Client::AWSAuthV4Signer::PayloadSigningPolicy::Never,
+        false
+    );
+}
+
+S3SdkObjectStore::~S3SdkObjectStore() {
+    _threadPool.join();
+}
+
+asio::awaitable<ObjectStore::GetOutcome> S3SdkObjectStore::get(
+    const std::string& bucket, 
+    const std::string& key,
+    const std::string& ifNoneMatch
+) {
+    _requests++;
+    co_return co_await asio::co_spawn(
+        _threadPool.get_executor(), 
+        [s3Cli = _s3Cli, bucket, key, ifNoneMatch]() mutable -> asio::awaitable<GetOutcome> {
+            Aws::S3::Model::GetObjectRequest req;
+            req.SetBucket(bucket);
+            req.SetKey(key);
+            if (!ifNoneMatch.empty())
+                req.SetIfNoneMatch(ifNoneMatch);
+
+            // the factory runs once per attempt, so a retried GET starts from an empty buffer
+            auto sink = std::make_shared<VectorStreamBuf>();
+            req.SetResponseStreamFactory([sink]() {
+                sink->data.clear();
+                return Aws::New<Aws::IOStream>("GetR2ObjectBody", sink.get());
+            });
+            req.SetHeadersReceivedEventHandler([sink](const Aws::Http::HttpRequest*, Aws::Http::HttpResponse* res) {
+                if (res->HasHeader("content-length"))
+                    sink->data.reserve(std::stoull(res->GetHeader("content-length")));
+            });
+
+            const auto out = s3Cli->GetObject(req);
+
+            GetOutcome obj;
+
+            if (out.IsSuccess()) {
+                const auto& res = out.GetResult();
+                auto cached = std::make_shared<CachedObject>();
+                for (const auto& [k, v] : res.GetMetadata())
+                    cached->metadata[k] = v;
+                cached->etag = res.GetETag();
+                cached->lastModified = res.GetLastModified().ToGmtString(Aws::Utils::DateFormat::RFC822);
+                cached->body = std::move(sink->data);
+                obj = GetOutcome::fromObject(std::move(cached));
+            } else if (out.GetError().GetResponseCode() == Aws::Http::HttpResponseCode::NOT_MODIFIED) {
+                obj.notModified = true;
+            } else {
+                obj.err = true;
+                const auto& err = out.GetError();
+                obj.errType = err.GetErrorType();
+                obj.retryable = err.ShouldRetry();
+                obj.errMsg = "R2 GetObject error: " + err.GetMessage();
+            }
+
+            co_return obj;
+        }, asio::use_awaitable);
+        
+}
+
+asio::awaitable<ObjectStore::GetOutcome> S3SdkObjectStore::head(
+    const std::string& bucket,
+    const std::string& key
+) {
+    _requests++;
+    co_return co_await asio::co_spawn(
+        _threadPool.get_executor(), 
+        [s3Cli = _s3Cli, bucket, key]() mutable -> asio::awaitable<GetOutcome> {
+            Aws::S3::Model::HeadObjectRequest req;
+            req.SetBucket(bucket);
+            req.SetKey(key);
+
+            const auto out = s3Cli->HeadObject(req);
+            GetOutcome obj;
+
+            if (out.IsSuccess()) {
+                const auto& res = out.GetResult();
+                for (const auto& [k, v] : res.GetMetadata())
+                    obj.metadata[k] = v;
+            } else {
+                obj.err = true;
+                const auto& err = out.GetError();
+                obj.errType = err.GetErrorType();
+                obj.retryable = err.ShouldRetry();
+                obj.errMsg = "R2 GetObject error: " + err.GetMessage();
+            }
+
+            co_return obj;
+        }, asio::use_awaitable);
+}
+
+asio::awaitable<ObjectStore::GetOutcome> S3SdkObjectStore::getRange(
+    const std::string& bucket,
+    const std::string& key,
+    uint64_t offset,
+    uint64_t length
+) {
+    _requests++;
+    auto read = [s3Cli = _s3Cli, bucket, key, offset, length]() -> asio::awaitable<GetOutcome> {
+        Aws::S3::Model::GetObjectRequest req;
+        req.SetBucket(bucket);
+        req.SetKey(key);
+        req.SetRange(fmt::format("bytes={}-{}", offset, offset + length - 1));
+
+        auto sink = std::make_shared<VectorStreamBuf>();
+        req.SetResponseStreamFactory([sink]() {
+            sink->data.clear();
+            return Aws::New<Aws::IOStream>("GetR2ObjectRange", sink.get());
+        });
+        sink->data.reserve(length);
+
+        const auto out = s3Cli->GetObject(req);
+
+        GetOutcome obj;
+        if (out.IsSuccess()) {
+            const auto& res = out.GetResult();
+            auto part = std::make_shared<CachedObject>();
+            part->etag = res.GetETag();
+            part->lastModified = res.GetLastModified().ToGmtString(Aws::Utils::DateFormat::RFC822);
+            part->body = std::move(sink->data);
+            obj = GetOutcome::fromObject(std::move(part));
+        } else {
+            obj.err = true;
+            const auto& err = out.GetError();
+            obj.errType = err.GetErrorType();
+            obj.retryable = err.ShouldRetry();
+            obj.errMsg = "R2 GetObject range error: " + err.GetMessage();
+        }
+        co_return obj;
+    };
+    co_return co_await asio::co_spawn(_threadPool.get_executor(), std::move(read), asio::use_awaitable);
+}
+
+asio::awaitable<ObjectStore::PutOutcome> S3SdkObjectStore::put(
+    const std::string& bucket,
+    const std::string& key,
+    const std::string& contentType,
+    std::shared_ptr<const std::vector<uint8_t>> data
+) {
+    _requests++;
+    co_return co_await asio::co_spawn(
+        _threadPool.get_executor(), 
+        [s3Cli = _s3Cli, bucket, key, contentType, data]() mutable -> asio::awaitable<PutOutcome> {
+            Aws::S3::Model::PutObjectRequest req;
+            req.SetBucket(bucket);
+            req.SetKey(key);
+
+            // read the payload in place, the stream buffer is seekable so retries can rewind.
+            // it is only ever read from
+            Aws::Utils::Stream::PreallocatedStreamBuf streamBuf(const_cast<uint8_t*>(data->data()), data->size());
+            req.SetBody(Aws::MakeShared<Aws::IOStream>("PutR2ObjectBody", &streamBuf));
+            req.SetContentLength(data->size());
+            req.SetContentType(contentType);
+
+            const auto out = s3Cli->PutObject(req);
+            PutOutcome obj;
+            
+            if (!out.IsSuccess()) {
+                const auto& err = out.GetError();
+                obj.err = true;
+                obj.errType = err.GetErrorType();
+                obj.retryable = err.ShouldRetry();
+                obj.errMsg = "R2 PutObject error: " + err.GetMessage();
+            } else
+                obj.etag = out.GetResult().GetETag();
+
+            co_return obj;
+        }, asio::use_awaitable
+    );
+}
+
+asio::awaitable<void> S3SdkObjectStore::keepWarm(const std::string& bucket, const std::atomic<bool>& stop) {
+    const auto exec = co_await asio::this_coro::executor;
+    asio::steady_timer timer(exec);
+    uint64_t lastRequests = 0;
+    for (int64_t tick = 0;; ++tick) {
+        if (tick % CONFIG::HTTP_KEEPALIVE_SEC == 0) {
+            // only while quiet, busy connections don't need pinging
+            if (tick == 0 || _requests == lastRequests)
+                for (size_t i = 0; i < CONFIG::R2_PREWARM_CONNECTIONS; ++i)
+                    asio::co_spawn(exec, head(bucket, ".warm"), asio::detached);
+            lastRequests = _requests;
+        }
+
+        // tick every second so shutdown isn't held up by a long timer
+        timer.expires_after(std::chrono::seconds(1));
+        co_await timer.async_wait(asio::use_awaitable);
+        if (stop.load(std::memory_order_relaxed))
+            break;
+    }
+}
+
+S3NativeObjectStore::S3NativeObjectStore(
+    const std::string& endPoint,
+    const std::string& accessKey,
+    const std::string& secretKey,
+    size_t maxIdleConnections
+) : _cli(endPoint, accessKey, secretKey, maxIdleConnections) {}
+
+asio::awaitable<ObjectStore::GetOutcome> S3NativeObjectStore::get(
+    const std::string& bucket, 
+    const std::string& key,
+    const std::string& ifNoneMatch
+) {
+    auto res = co_await _cli.getObject(bucket, key, false, ifNoneMatch);
+    GetOutcome obj;
+    if (!res.err && res.status == 304)
+        obj.notModified = true;
+    else if (!res.err && res.status == 200) {
+        auto cached = std::make_shared<CachedObject>();
+        cached->body = std::move(res.body);
+        cached->metadata = std::move(res.metadata);
+        cached->etag = std::move(res.etag);
+        cached->lastModified = std::move(res.lastModified);
+        obj = GetOutcome::fromObject(std::move(cached));
+    } else {
+        obj.err = true;
+        obj.errType = httpErrorType(res);
+        obj.retryable = httpRetryable(res);
+        obj.errMsg = "R2 GetObject error: " + httpErrorMsg(res);
+    }
+    co_return obj;
+}
+
+asio::awaitable<ObjectStore::GetOutcome> S3NativeObjectStore::head(
+    const std::string& bucket,
+    const std::string& key
+) {
+    auto res = co_await _cli.getObject(bucket, key, true);
+    GetOutcome obj;
+    if (!res.err && res.status == 200)
+        obj.metadata = std::move(res.metadata);
+    else {
+        obj.err = true;
+        obj.errType = httpErrorType(res);
+        obj.retryable = httpRetryable(res);
+        obj.errMsg = "R2 GetObject error: " + httpErrorMsg(res);
+    }
+    co_return obj;
+}
+
+asio::awaitable<ObjectStore::GetOutcome> S3NativeObjectStore::getRange(
+    const std::string& bucket,
+    const std::string& key,
+    uint64_t offset,
+    uint64_t length
+) {
+    auto res = co_await _cli.getObject(bucket, key, false, "", fmt::format("bytes={}-{}", offset, offset + length - 1));
+    GetOutcome obj;
+    // a 200 means the range covered the whole object
+    if (!res.err && (res.status == 206 || res.status == 200)) {
+        auto part = std::make_shared<CachedObject>();
+        part->body = std::move(res.body);
+        part->etag = std::move(res.etag);
+        part->lastModified = std::move(res.lastModified);
+        obj = GetOutcome::fromObject(std::move(part));
+    } else {
+        obj.err = true;
+        obj.errType = httpErrorType(res);
+        obj.retryable = httpRetryable(res);
+        obj.errMsg = "R2 GetObject range error: " + httpErrorMsg(res);
+    }
+    co_return obj;
+}
+
+asio::awaitable<ObjectStore::PutOutcome> S3NativeObjectStore::put(
+    const std::string& bucket,
+    const std::string& key,
+    const std::string& contentType,
+    std::shared_ptr<const std::vector<uint8_t>> data
+) {
+    auto res = co_await _cli.putObject(bucket, key, contentType, *data);
+    PutOutcome obj;
+    if (res.err || res.status != 200) {
+        obj.err = true;
+        obj.errType = httpErrorType(res);
+        obj.retryable = httpRetryable(res);
+        obj.errMsg = "R2 PutObject error: " + httpErrorMsg(res);
+    } else
+        obj.etag = std::move(res.etag);
+    co_return obj;
+}
+
+asio::awaitable<void> S3NativeObjectStore::keepWarm(const std::string& bucket, const std::atomic<bool>& stop) {
+    co_await _cli.keepWarm(bucket, CONFIG::R2_PREWARM_CONNECTIONS, stop);
+}
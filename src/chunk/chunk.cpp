@@ -31,6 +31,10 @@ std::pair<uint64_t,uint64_t> Chunk::parseIdStr(const std::string& id){
 
 }
 
+bool Chunk::writeBack(const std::string& id){
+    return CONFIG::R2_WRITE_BACK && !id.empty() && id[0] == 'l' && parseIdStr(id).first <= 1;
+}
+
 const std::vector<uint32_t>& Chunk::mapFwd(int layer, size_t idx) {
 
     if(layer == 0){
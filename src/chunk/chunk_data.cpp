@@ -6,6 +6,10 @@
 #include <cstdint>
 #include <bit>
 #include <cstring>
+#include <atomic>
+#include <unordered_set>
+#include <algorithm>
+#include <span>
 
 #include <aws/s3/S3Client.h>
 #include <aws/s3/model/GetObjectRequest.h>
@@ -13,12 +17,14 @@
 #include <aws/core/utils/memory/stl/AWSStreamFwd.h> 
 #include <opencv2/core.hpp>
 #include <boost/asio/awaitable.hpp>
+#include <boost/asio/this_coro.hpp>
 #include <fmt/format.h>
 
 #include "config/config.hpp"
 #include "chunk/chunk_data.hpp"
 #include "chunk/chunk.hpp"
 #include "async/cf_async_client.hpp"
+#include "utils/splicer.hpp"
 
 ChunkData::ChunkData(
     std::string chunkId, 
@@ -33,13 +39,188 @@ ChunkData::ChunkData(
         _needsUpdate.push_back(stoll(s, nullptr, 16));
 }
 
+uint64_t ChunkData::nextJobId() {
+    static std::atomic<uint64_t> counter{1};
+    return counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string ChunkData::dictName(const std::string& bucket) const {
+    return _chunkId[0] == 'l' ? fmt::format("{}_l{}", bucket, _idl) : bucket;
+}
+
+asio::awaitable<Codec::Decoded> ChunkData::decode(std::span<const uint8_t> body) const {
+    co_return co_await Codec::decodeOn(_cpuExec ? _cpuExec : co_await asio::this_coro::executor, body);
+}
+
+asio::awaitable<std::vector<uint8_t>> ChunkData::encode(std::vector<uint8_t>&& buf, bool compress, const std::string& bucket, uint8_t layout) const {
+    co_return co_await Codec::encodeOn(
+        _cpuExec ? _cpuExec : co_await asio::this_coro::executor,
+        std::move(buf),
+        compress ? Codec::Type::Zstd : Codec::Type::None,
+        dictName(bucket),
+        layout
+    );
+}
+
 constexpr size_t PART_ID_SIZE = sizeof(uint64_t);
 constexpr size_t PART_LEN_SIZE = sizeof(uint32_t);
 
+// version 2: | header | count | count x (id, offset, len) sorted by id | parts in id order |
+// offsets are from the start of the object
+constexpr size_t INDEX_COUNT_SIZE = sizeof(uint32_t);
+constexpr size_t INDEX_OFFSET_SIZE = sizeof(uint32_t);
+constexpr size_t INDEX_ENTRY_SIZE = PART_ID_SIZE + INDEX_OFFSET_SIZE + PART_LEN_SIZE;
+
+struct IndexEntry {
+    uint64_t id;
+    uint32_t offset;
+    uint32_t len;
+};
+
+static size_t indexEnd(size_t count) {
+    return Codec::HEADER_SIZE + INDEX_COUNT_SIZE + count * INDEX_ENTRY_SIZE;
+}
+
+static uint32_t indexCount(std::span<const uint8_t> body) {
+    if (body.size() < indexEnd(0))
+        throw std::runtime_error("Chunk index is truncated");
+    uint32_t count;
+    std::memcpy(&count, body.data() + Codec::HEADER_SIZE, INDEX_COUNT_SIZE);
+    return count;
+}
+
+// body must hold the whole index
+static IndexEntry indexEntry(std::span<const uint8_t> body, size_t k) {
+    IndexEntry e;
+    const uint8_t* p = body.data() + indexEnd(k);
+    std::memcpy(&e.id, p, PART_ID_SIZE);
+    std::memcpy(&e.offset, p + PART_ID_SIZE, INDEX_OFFSET_SIZE);
+    std::memcpy(&e.len, p + PART_ID_SIZE + INDEX_OFFSET_SIZE, PART_LEN_SIZE);
+    return e;
+}
+
+// calls fn(id, part) for every part of a version 0/1 payload
+template<typename Fn>
+static void forEachPart(std::span<const uint8_t> body, Fn&& fn) {
+    size_t i = 0;
+    while (i < body.size()) {
+        if (i + PART_ID_SIZE + PART_LEN_SIZE > body.size())
+            throw std::runtime_error("Chunk part header is truncated");
+
+        // read id (64 bit int little endian)
+        uint64_t id;
+        std::memcpy(&id, body.data() + i, PART_ID_SIZE);
+        i += PART_ID_SIZE;
+
+        // read part len metadata (32 bit int little endian)
+        uint32_t partLen;
+        std::memcpy(&partLen, body.data() + i, PART_LEN_SIZE);
+        i += PART_LEN_SIZE;
+
+        if (partLen > body.size() - i)
+            throw std::runtime_error(fmt::format("Chunk part {:x} is out of bounds", id));
+        fn(id, body.subspan(i, partLen));
+        i += partLen;
+    }
+}
+
+// the same for a whole version 2 object
+template<typename Fn>
+static void forEachIndexedPart(std::span<const uint8_t> body, Fn&& fn) {
+    const uint32_t count = indexCount(body);
+    if (body.size() < indexEnd(count))
+        throw std::runtime_error("Chunk index is truncated");
+    for (size_t k = 0; k < count; ++k) {
+        const auto e = indexEntry(body, k);
+        if (static_cast<size_t>(e.offset) + e.len > body.size())
+            throw std::runtime_error(fmt::format("Chunk part {:x} is out of bounds", e.id));
+        fn(e.id, body.subspan(e.offset, e.len));
+    }
+}
+
+// offset of part in base, npos if it doesn't point into it
+static size_t offsetIn(std::span<const uint8_t> base, std::span<const uint8_t> part) {
+    const auto b = reinterpret_cast<uintptr_t>(base.data());
+    const auto p = reinterpret_cast<uintptr_t>(part.data());
+    if (base.empty() || p < b || p + part.size() > b + base.size())
+        return std::string::npos;
+    return p - b;
+}
+
+// parts come sorted by id, so a part that kept its place is adjacent to its predecessor in
+// the old body and only changed parts break the bulk copy
+static std::vector<uint8_t> packParts(const PartStore& parts) {
+    size_t size = Codec::HEADER_SIZE + parts.bytes(); // version and codec
+    size += parts.size() * (PART_ID_SIZE + PART_LEN_SIZE);
+
+    std::vector<uint8_t> data(size);
+    Splicer out(data.data() + Codec::HEADER_SIZE);
+    const auto base = parts.base();
+    const bool sequentialBase = parts.baseVersion() != Codec::VERSION_INDEXED;
+    for(const auto& [id, part, owned, head] : parts){
+        // views into a sequential body still have their id and len in front of them
+        const size_t offset = owned.empty() && head.empty() && sequentialBase ? offsetIn(base, part) : std::string::npos;
+        if (offset != std::string::npos && offset >= PART_ID_SIZE + PART_LEN_SIZE) {
+            out.splice(part.data() - PART_ID_SIZE - PART_LEN_SIZE, PART_ID_SIZE + PART_LEN_SIZE + part.size());
+            continue;
+        }
+
+        // id and part len metadata (little endian)
+        std::array<uint8_t, PART_ID_SIZE + PART_LEN_SIZE> header;
+        const uint32_t partLen = head.size() + part.size();
+        std::memcpy(header.data(), &id, PART_ID_SIZE);
+        std::memcpy(header.data() + PART_ID_SIZE, &partLen, PART_LEN_SIZE);
+        out.write(header.data(), header.size());
+        if (!head.empty())
+            out.write(head.data(), head.size());
+        out.splice(part.data(), part.size());
+    }
+    out.flush();
+    return data;
+}
+
+// parts come sorted by id, so the index can be binary searched
+static std::vector<uint8_t> packPartsIndexed(const PartStore& parts) {
+    const size_t size = indexEnd(parts.size()) + parts.bytes();
+    if (size > UINT32_MAX)
+        throw std::runtime_error("Chunk is too large for 32 bit part offsets");
+
+    std::vector<uint8_t> data(size);
+    data[0] = Codec::VERSION_INDEXED;
+    data[1] = Codec::codecByte(Codec::Type::None, parts.layout());
+    const uint32_t count = parts.size();
+    std::memcpy(data.data() + Codec::HEADER_SIZE, &count, INDEX_COUNT_SIZE);
+
+    // parts of an indexed body are back to back, unchanged ones splice into one copy
+    size_t entry = indexEnd(0);
+    size_t i = indexEnd(count);
+    Splicer out(data.data() + i);
+    for (const auto& [id, part, _, head] : parts) {
+        const uint32_t offset = i;
+        const uint32_t partLen = head.size() + part.size();
+        std::memcpy(data.data() + entry, &id, PART_ID_SIZE);
+        std::memcpy(data.data() + entry + PART_ID_SIZE, &offset, INDEX_OFFSET_SIZE);
+        std::memcpy(data.data() + entry + PART_ID_SIZE + INDEX_OFFSET_SIZE, &partLen, PART_LEN_SIZE);
+        entry += INDEX_ENTRY_SIZE;
+
+        if (!head.empty())
+            out.write(head.data(), head.size());
+        out.splice(part.data(), part.size());
+        i += partLen;
+    }
+    out.flush();
+    return data;
+}
+
 asio::awaitable<void> ChunkData::downloadParts(const std::shared_ptr<CFAsyncClient> cfCli, bool keepAll) {
   
     // get with cache
-    auto obj = co_await cfCli->getR2Object(VARS::CF_CHUNKS_BUCKET, _chunkId, true);
+    auto obj = co_await cfCli->getR2Object(
+        VARS::CF_CHUNKS_BUCKET, 
+        _chunkId, 
+        true, 
+        requestContext(RequestScheduler::Priority::Critical)
+    );
     if (obj.err) {
         if (obj.errType != Aws::S3::S3Errors::NO_SUCH_KEY)
             throw std::runtime_error(obj.errMsg);
@@ -47,61 +228,172 @@ asio::awaitable<void> ChunkData::downloadParts(const std::shared_ptr<CFAsyncClie
     }
     
     std::unordered_set<uint64_t> nuSet(_needsUpdate.begin(), _needsUpdate.end());
-    
-    size_t i = 2; // first 2 bytes reserved
-    while (i < obj.body.size()) {
-        // read id (64 bit int little endian)
-        uint64_t id;
-        std::memcpy(&id, obj.body.data() + i, PART_ID_SIZE);
-        i += PART_ID_SIZE;
 
-        // read part len metadata (32 bit int little endian)
-        uint32_t partLen;
-        std::memcpy(&partLen, obj.body.data() + i, PART_LEN_SIZE);
-        i += PART_LEN_SIZE;
+    // if keep all false, only keep items that do not need update
+    const auto keep = [&](uint64_t id, std::span<const uint8_t> part) {
+        if (keepAll || !nuSet.contains(id))
+            _parts.view(id, part);
+    };
 
-        // if keep all false, only keep items that do not need update
-        if (keepAll || (!keepAll && !nuSet.contains(id))) {
-            std::vector<uint8_t> part(partLen);
-            std::memcpy(part.data(), obj.body.data() + i, partLen);
-            _parts.emplace(id, std::move(part));
-        }
-        i += partLen;
+    // parts stay views into the body
+    _parts.adopt(obj.owner);
+    _parts.setLayout(Codec::layoutOf(obj.body));
+    if (!obj.body.empty() && obj.body[0] == Codec::VERSION_INDEXED) {
+        forEachIndexedPart(obj.body, keep);
+        _parts.setBase(obj.body, Codec::VERSION_INDEXED);
+        co_return;
     }
+
+    // the payload of a compressed object is in decoded.owned, moving it keeps the buffer
+    auto decoded = co_await decode(obj.body);
+    forEachPart(decoded.payload, keep);
+    _parts.setBase(decoded.payload, Codec::VERSION_RAW);
+    if (!decoded.owned.empty())
+        _parts.adopt(std::make_shared<const std::vector<uint8_t>>(std::move(decoded.owned)));
 }
 
-asio::awaitable<void> ChunkData::uploadParts(const std::shared_ptr<CFAsyncClient> cfCli) const {
+asio::awaitable<PartStore> ChunkData::readParts(
+    const std::shared_ptr<CFAsyncClient> cfCli,
+    std::vector<uint64_t> ids
+) const {
+    const auto ctx = requestContext(RequestScheduler::Priority::Normal);
+    PartStore out;
+    std::ranges::sort(ids);
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
 
-    assert(!_parts.empty() && "Cannot upload empty chunk");
+    const std::unordered_set<uint64_t> wanted(ids.begin(), ids.end());
+    const auto keep = [&](uint64_t id, std::span<const uint8_t> part) {
+        if (wanted.contains(id))
+            out.view(id, part);
+    };
 
-    // encode parts
-    size_t size = 2; // reserve first 2 bytes (version)
-    for(auto& [key, part] : _parts)
-        size += PART_ID_SIZE + PART_LEN_SIZE + part.size();
+    // the index of a version 2 object is in its first bytes
+    auto probe = co_await cfCli->getR2ObjectRange(VARS::CF_CHUNKS_BUCKET, _chunkId, 0, CONFIG::CHUNK_INDEX_PROBE, true, ctx);
+    if (probe.err) {
+        if (probe.errType != Aws::S3::S3Errors::NO_SUCH_KEY)
+            throw std::runtime_error(probe.errMsg);
+        co_return out;
+    }
+    const bool whole = probe.body.size() < CONFIG::CHUNK_INDEX_PROBE;
+    out.setLayout(Codec::layoutOf(probe.body));
 
-    std::vector<uint8_t> data(size);
-    size_t i = 2; // first two bytes reserved
-    for(auto& [id, part] : _parts){
-        // set id
-        std::memcpy(data.data() + i, &id, PART_ID_SIZE);
-        i += PART_ID_SIZE;
+    // older versions are read whole
+    if (probe.body.empty() || probe.body[0] != Codec::VERSION_INDEXED) {
+        if (!whole) {
+            probe = co_await cfCli->getR2Object(VARS::CF_CHUNKS_BUCKET, _chunkId, true, ctx);
+            if (probe.err)
+                throw std::runtime_error(probe.errMsg);
+        }
+        out.adopt(probe.owner);
+        auto decoded = co_await decode(probe.body);
+        forEachPart(decoded.payload, keep);
+        if (!decoded.owned.empty())
+            out.adopt(std::make_shared<const std::vector<uint8_t>>(std::move(decoded.owned)));
+        co_return out;
+    }
 
-        // set part len metadata
-        uint32_t partLen = part.size();
-        std::memcpy(data.data() + i, &partLen, PART_LEN_SIZE);
-        i += PART_LEN_SIZE;
+    // a replaced object between requests would mix two versions
+    const auto sameObject = [&](const CFAsyncClient::GetOutcome& obj) {
+        if (obj.err)
+            throw std::runtime_error(obj.errMsg);
+        if (!obj.etag.empty() && !probe.etag.empty() && obj.etag != probe.etag)
+            throw std::runtime_error(fmt::format("Chunk {} changed while reading parts", _chunkId));
+    };
 
-        // set part
-        std::memcpy(data.data() + i, part.data(), part.size());
-        i += partLen;
+    // rest of the index when it didn't fit in the probe
+    std::span<const uint8_t> index = probe.body;
+    std::shared_ptr<const void> indexOwner = probe.owner;
+    const uint32_t count = indexCount(index);
+    if (index.size() < indexEnd(count)) {
+        if (whole)
+            throw std::runtime_error("Chunk index is truncated");
+        const auto rest = co_await cfCli->getR2ObjectRange(
+            VARS::CF_CHUNKS_BUCKET, _chunkId, index.size(), indexEnd(count) - index.size(), true, ctx
+        );
+        sameObject(rest);
+        auto buf = std::make_shared<std::vector<uint8_t>>();
+        buf->reserve(index.size() + rest.body.size());
+        buf->insert(buf->end(), index.begin(), index.end());
+        buf->insert(buf->end(), rest.body.begin(), rest.body.end());
+        index = *buf;
+        indexOwner = std::move(buf);
+        if (index.size() < indexEnd(count))
+            throw std::runtime_error("Chunk index is truncated");
+    }
+
+    // binary search each id, entries are sorted
+    std::vector<IndexEntry> found;
+    found.reserve(ids.size());
+    for (const auto id : ids) {
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (indexEntry(index, mid).id < id)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < count && indexEntry(index, lo).id == id)
+            found.push_back(indexEntry(index, lo));
+    }
+    std::ranges::sort(found, {}, &IndexEntry::offset);
+
+    // parts already read come from the probe, nearby ones share a range
+    std::vector<CFAsyncClient::GetParams> requests;
+    std::vector<uint64_t> rangeStarts;
+    std::vector<std::pair<IndexEntry, size_t>> pending; // entry, request
+    for (const auto& e : found) {
+        const uint64_t end = static_cast<uint64_t>(e.offset) + e.len;
+        if (end <= index.size()) {
+            out.view(e.id, index.subspan(e.offset, e.len));
+            continue;
+        }
+        if (whole)
+            throw std::runtime_error(fmt::format("Chunk part {:x} is out of bounds", e.id));
+
+        if (!requests.empty() && e.offset <= rangeStarts.back() + requests.back().rangeLength + CONFIG::CHUNK_RANGE_MERGE_GAP)
+            requests.back().rangeLength = end - rangeStarts.back();
+        else {
+            requests.push_back({VARS::CF_CHUNKS_BUCKET, _chunkId, false, true, e.offset, e.len});
+            rangeStarts.push_back(e.offset);
+        }
+        pending.emplace_back(e, requests.size() - 1);
     }
+    out.adopt(std::move(indexOwner));
+    if (requests.empty())
+        co_return out;
+
+    const auto ranges = co_await cfCli->getManyR2Objects(std::move(requests), ctx);
+    for (const auto& [e, r] : pending) {
+        const auto& obj = ranges[r];
+        sameObject(obj);
+        const size_t at = e.offset - rangeStarts[r];
+        if (at + e.len > obj.body.size())
+            throw std::runtime_error(fmt::format("Chunk part {:x} is out of bounds", e.id));
+        out.view(e.id, obj.body.subspan(at, e.len));
+    }
+    for (const auto& obj : ranges)
+        out.adopt(obj.owner);
+    co_return out;
+}
+
+asio::awaitable<void> ChunkData::uploadParts(const std::shared_ptr<CFAsyncClient> cfCli) const {
+
+    assert(!_parts.empty() && "Cannot upload empty chunk");
+
+    // indexed chunks stay uncompressed so they can be read by range
+    std::vector<uint8_t> data = CONFIG::CHUNK_FORMAT_INDEXED
+        ? packPartsIndexed(_parts)
+        : co_await encode(packParts(_parts), CONFIG::COMPRESS_CHUNKS, VARS::CF_CHUNKS_BUCKET, _parts.layout());
 
     auto out = co_await cfCli->putR2Object(
         VARS::CF_CHUNKS_BUCKET, 
         _chunkId, 
         "application/octet-stream", 
         std::move(data),
-        true
+        true,
+        requestContext(RequestScheduler::Priority::Critical),
+        Chunk::writeBack(_chunkId)
     );
 
     if (out.err)
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "chunk/part_store.hpp"
+
+void PartStore::adopt(std::shared_ptr<const void> owner) {
+    _owners.push_back(std::move(owner));
+}
+
+void PartStore::view(uint64_t id, std::span<const uint8_t> part) {
+    auto& e = slot(id);
+    e.owned.clear();
+    e.owned.shrink_to_fit();
+    e.head.clear();
+    e.data = part;
+}
+
+void PartStore::set(uint64_t id, std::vector<uint8_t>&& part) {
+    // moving a vector keeps its buffer, so data stays valid when _entries grows
+    auto& e = slot(id);
+    e.owned = std::move(part);
+    e.head.clear();
+    e.data = e.owned;
+}
+
+void PartStore::setHead(uint64_t id, size_t n, std::vector<uint8_t>&& head) {
+    const auto it = std::ranges::lower_bound(_entries, id, {}, &Entry::id);
+    if (it == _entries.end() || it->id != id)
+        throw std::runtime_error("Cannot set the head of a missing part");
+    if (n > it->data.size())
+        throw std::runtime_error("Part head is larger than the part");
+    // data may point into owned, which stays as it is
+    it->data = it->data.subspan(n);
+    it->head = std::move(head);
+}
+
+void PartStore::erase(uint64_t id) {
+    const auto it = std::ranges::lower_bound(_entries, id, {}, &Entry::id);
+    if (it != _entries.end() && it->id == id)
+        _entries.erase(it);
+}
+
+std::span<const uint8_t> PartStore::get(uint64_t id) const {
+    const Entry* e = find(id);
+    return e ? e->data : std::span<const uint8_t>{};
+}
+
+std::span<const uint8_t> PartStore::head(uint64_t id) const {
+    const Entry* e = find(id);
+    return e ? std::span<const uint8_t>(e->head) : std::span<const uint8_t>{};
+}
+
+size_t PartStore::bytes() const {
+    size_t n = 0;
+    for (const auto& e : _entries)
+        n += e.head.size() + e.data.size();
+    return n;
+}
+
+void PartStore::clear() {
+    _entries.clear();
+    _owners.clear();
+    _base = {};
+    _layout = 0;
+}
+
+const PartStore::Entry* PartStore::find(uint64_t id) const {
+    const auto it = std::ranges::lower_bound(_entries, id, {}, &Entry::id);
+    return it != _entries.end() && it->id == id ? &*it : nullptr;
+}
+
+PartStore::Entry& PartStore::slot(uint64_t id) {
+    // objects list parts in id order, so appends are the common case
+    if (_entries.empty() || _entries.back().id < id)
+        return _entries.emplace_back(Entry{id, {}, {}, {}});
+    const auto it = std::ranges::lower_bound(_entries, id, {}, &Entry::id);
+    if (it != _entries.end() && it->id == id)
+        return *it;
+    return *_entries.insert(it, Entry{id, {}, {}, {}});
+}
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "chunk/point_cloud_store.hpp"
+
+void PointCloudStore::reserve(size_t entries, size_t points) {
+    _entries.reserve(entries);
+    _x.reserve(points);
+    _y.reserve(points);
+    _z.reserve(points);
+    _colors.reserve(points);
+}
+
+PointCloudStore::Entry PointCloudStore::add(uint64_t id, uint32_t n) {
+    remove(id);
+    if (_colors.size() - _points > _points)
+        compact();
+    if (_colors.size() + n > UINT32_MAX)
+        throw std::runtime_error("Point cloud is too large for 32 bit offsets");
+
+    const Entry e{id, static_cast<uint32_t>(_colors.size()), n};
+    _x.resize(_x.size() + n);
+    _y.resize(_y.size() + n);
+    _z.resize(_z.size() + n);
+    _colors.resize(_colors.size() + n);
+    _points += n;
+
+    // objects list entries in id order, so appends are the common case
+    if (_entries.empty() || _entries.back().id < id)
+        _entries.push_back(e);
+    else
+        _entries.insert(std::ranges::lower_bound(_entries, id, {}, &Entry::id), e);
+    return e;
+}
+
+void PointCloudStore::remove(uint64_t id) {
+    const auto it = std::ranges::lower_bound(_entries, id, {}, &Entry::id);
+    if (it == _entries.end() || it->id != id)
+        return;
+    _points -= it->count;
+    _entries.erase(it);
+}
+
+void PointCloudStore::clear() {
+    _entries.clear();
+    _x.clear();
+    _y.clear();
+    _z.clear();
+    _colors.clear();
+    _points = 0;
+}
+
+const PointCloudStore::Entry* PointCloudStore::find(uint64_t id) const {
+    const auto it = std::ranges::lower_bound(_entries, id, {}, &Entry::id);
+    return it != _entries.end() && it->id == id ? &*it : nullptr;
+}
+
+void PointCloudStore::compact() {
+    std::vector<float> x(_points), y(_points), z(_points);
+    std::vector<uint16_t> colors(_points);
+    uint32_t offset = 0;
+    for (auto& e : _entries) {
+        std::copy_n(_x.begin() + e.offset, e.count, x.begin() + offset);
+        std::copy_n(_y.begin() + e.offset, e.count, y.begin() + offset);
+        std::copy_n(_z.begin() + e.offset, e.count, z.begin() + offset);
+        std::copy_n(_colors.begin() + e.offset, e.count, colors.begin() + offset);
+        e.offset = offset;
+        offset += e.count;
+    }
+    _x = std::move(x);
+    _y = std::move(y);
+    _z = std::move(z);
+    _colors = std::move(colors);
+}
@@ -19,6 +19,10 @@
 
 asio::awaitable<std::optional<std::string>> BaseChunk::update(const std::shared_ptr<CFAsyncClient> cfCli) {
 
+    // same builds, so the point clouds above stay as they are too
+    if (_unchanged)
+        co_return std::nullopt;
+
     co_await uploadParts(cfCli);
     co_await uploadImages(cfCli);
 
@@ -27,7 +31,7 @@ asio::awaitable<std::optional<std::string>> BaseChunk::update(const std::shared_
     // get point cloud vectors from build data
     std::mt19937 rng{std::random_device{}()};
     for (const auto& id : _needsUpdate) {
-        const auto& part = _parts[id];
+        const auto part = _parts.get(id);
         const auto buildData = Plot::getBuildPart(part);
 
         // extract non-empty block position and color indices
@@ -56,8 +60,8 @@ asio::awaitable<std::optional<std::string>> BaseChunk::update(const std::shared_
         std::shuffle(build.begin(), build.end(), rng);
 
         const size_t k = std::max(2ul, static_cast<size_t>(std::sqrt(build.size())));
-        cv::Mat points(k, 3, CV_32F);    
-        std::vector<uint16_t> colidxs(k); 
+        const auto e = _pointClouds.add(id, k);
+        const auto colidxs = _pointClouds.colors(e);
 
         cv::Vec3f worldPos = Utils::idxToVec3(Chunk::plotIdToPosIdx(id), VARS::MAIN_BUILD_SIZE);
         worldPos[1] += 1.f;
@@ -70,15 +74,14 @@ asio::awaitable<std::optional<std::string>> BaseChunk::update(const std::shared_
             pos /= buildSize;
             pos += worldPos;
 
-            std::memcpy(points.ptr<float>(i), pos.val, 3 * sizeof(float));
+            for (size_t j = 0; j < 3; ++j)
+                _pointClouds.axis(e, j)[i] = pos[j];
             colidxs[i] = build[i].second;
         }
-
-        _pointClouds[id] = PointCloud{std::move(points), std::move(colidxs)};
     }
   
 
-    if (!_pointClouds.empty()) {
+    if (hasPointClouds()) {
         co_await uploadPointCloud(cfCli);
 
         // make next update chunk id
@@ -4,6 +4,7 @@
 #include <stdexcept>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 #include <opencv2/core.hpp>
 #include <aws/s3/S3Client.h>
@@ -21,11 +22,28 @@
 namespace asio = boost::asio;
 
 asio::awaitable<void> DChunk::prep(const std::shared_ptr<CFAsyncClient> cfCli) {
-    co_await downloadParts(cfCli, true);
+    // new parts are made from the stored ones read by range, the whole chunk is only
+    // downloaded when one of them changes
     co_await downloadPlotUpdates(cfCli);
+    if (_unchanged)
+        co_return;
+
+    co_await downloadParts(cfCli, true);
+    for (size_t i = 0; i < _needsUpdate.size(); ++i) {
+        auto& part = _plotParts[i];
+        if (part.headOnly)
+            // only the header changes, the rest of the part isn't copied
+            _parts.setHead(_needsUpdate[i], Plot::META_HEADER_SIZE, std::move(part.data));
+        else
+            _parts.set(_needsUpdate[i], std::move(part.data));
+    }
+    _plotParts.clear();
 }
 
 void DChunk::process() {
+    if (_unchanged)
+        return;
+
     // create new images for plots that need update
     _updatedImages.reserve(_needsUpdate.size());
     for (size_t i = 0; i < _needsUpdate.size(); ++i) {
@@ -34,13 +52,15 @@ void DChunk::process() {
         if (_updateFlags[i].noImageUpdate)
             _updatedImages.push_back(std::nullopt);
         else {
-            const auto buildData = Plot::getBuildPart(_parts[plotId]);
+            const auto buildData = Plot::getBuildPart(_parts.get(plotId));
             _updatedImages.push_back(BuildImage::make(buildData));
         }
     }
 }
 
 asio::awaitable<std::optional<std::string>> DChunk::update(const std::shared_ptr<CFAsyncClient> cfCli) {
+    if (_unchanged)
+        co_return std::nullopt;
     co_await uploadParts(cfCli);
     co_await uploadImages(cfCli);
     co_return std::nullopt;
@@ -61,66 +81,97 @@ asio::awaitable<void> DChunk::downloadPlotUpdates(const std::shared_ptr<CFAsyncC
                 _updateFlags[i].metadataOnly || (_updateFlags[i].setDefaultBuild && _updateFlags[i].setDefaultJson)
             });
         }
-        updates = co_await cfCli->getManyR2Objects(std::move(requests));
+        updates = co_await cfCli->getManyR2Objects(std::move(requests), requestContext(RequestScheduler::Priority::Normal));
     }
 
-    
-    // set new plot data
+    // the stored parts of those plots, only the index and the parts themselves are read from
+    // indexed chunks
+    const PartStore stored = co_await readParts(cfCli, _needsUpdate);
+
+    // new plot data
+    _unchanged = true;
+    _plotParts.reserve(_needsUpdate.size());
     for (size_t i = 0; i < _needsUpdate.size(); ++i) {
-        const auto& plotId = _needsUpdate[i];
-        const auto& flags = _updateFlags[i];
         const auto& obj = updates[i];
 
         // file must exist here
         if (obj.err)
             throw std::runtime_error(obj.errMsg);
 
-        nlohmann::json json;
-        std::span<const std::uint8_t> buildPart;
-
-        // TODO meta data update not working fix
-
-        // metadata only means keep whatever is currently in the chunk and just change metadata field
-        // this is because HeadObject is used for metadata only update, so obj.body won't exist
-        // TODO: if ever a metadata only update is about to be queued, MUST first make sure that it won't overwrite a queued FULL update
-        if (flags.setDefaultJson)
-            json = Plot::getDefaultJsonPart();
-        else if (flags.metadataOnly)
-            json = Plot::getJsonPart(_parts[plotId]);
-        else
-            json = Plot::getJsonPart(obj.body);
-        
-        if (flags.setDefaultBuild)
-            buildPart = Plot::getDefaultBuildData();
-        else if (flags.metadataOnly)
-            buildPart = Plot::getBuildData(_parts[plotId]);
-        else
-            buildPart = Plot::getBuildData(obj.body);
+        const auto old = stored.get(_needsUpdate[i]);
+        auto part = makePlotPart(obj, _updateFlags[i], old);
+        if (!stored.contains(_needsUpdate[i])
+            || !std::ranges::equal(part.data, part.headOnly ? old.first(Plot::META_HEADER_SIZE) : old))
+            _unchanged = false;
+        _plotParts.push_back(std::move(part));
+    }
+}
 
-    
-        const auto itv = obj.metadata.find("verified");
-        if (itv == obj.metadata.end())
-            throw std::runtime_error("Plot missing verified metadata");
-        const auto ito = obj.metadata.find("owner");
-        if (ito == obj.metadata.end())
-            throw std::runtime_error("Plot missing owner metadata");
-
-        bool verified = itv->second == "true";
-        json["verified"] = verified;
-        json["owner"] = ito->second;
-
-        // remove subscriber features if needed
-        if (!verified) {
-            json["link"] = "";
-            json["linkTitle"] = "";
-        }
+DChunk::PlotPart DChunk::makePlotPart(
+    const CFAsyncClient::GetOutcome& obj,
+    const Plot::UpdateFlags& flags,
+    std::span<const uint8_t> stored
+) const {
+    const auto itv = obj.metadata.find("verified");
+    if (itv == obj.metadata.end())
+        throw std::runtime_error("Plot missing verified metadata");
+    const auto ito = obj.metadata.find("owner");
+    if (ito == obj.metadata.end())
+        throw std::runtime_error("Plot missing owner metadata");
+
+    const Plot::Meta meta{itv->second == "true", ito->second};
+    const bool metaHeader = CONFIG::PLOT_META_HEADER && Plot::fitsMetaHeader(meta);
+
+    // TODO meta data update not working fix
+
+    // metadata only means keep whatever is currently in the chunk and just change metadata field
+    // this is because HeadObject is used for metadata only update, so obj.body won't exist
+    // TODO: if ever a metadata only update is about to be queued, MUST first make sure that it won't overwrite a queued FULL update
+    const bool headerOnly = metaHeader && flags.metadataOnly && !flags.setDefaultJson && !flags.setDefaultBuild
+        && Plot::hasMetaHeader(stored)
+        && (meta.verified || !Plot::getMeta(stored).verified); // links already hidden or kept
+    if (headerOnly)
+        return {Plot::makeMetaHeader(meta), true};
+
+    std::span<const std::uint8_t> buildPart;
+    if (flags.setDefaultBuild)
+        buildPart = Plot::getDefaultBuildData();
+    else if (flags.metadataOnly)
+        buildPart = Plot::getBuildData(stored);
+    else
+        buildPart = Plot::getBuildData(obj.body);
+
+    nlohmann::json json;
+    if (flags.setDefaultJson)
+        json = Plot::getDefaultJsonPart();
+    else if (flags.metadataOnly)
+        json = Plot::getJsonPart(stored);
+    else
+        json = Plot::getJsonPart(obj.body);
+
+    // remove subscriber features if needed
+    if (!meta.verified) {
+        json["link"] = "";
+        json["linkTitle"] = "";
+    }
 
-        // repack plot data
-        _parts[plotId] = Plot::makePlotData(json, buildPart);
-         
+    // the header holds the server's fields, the user's json can't set them
+    if (metaHeader) {
+        json.erase("verified");
+        json.erase("owner");
+        const std::string jsonData = json.dump();
+        return {Plot::makePlotPart(
+            meta,
+            {reinterpret_cast<const std::uint8_t*>(jsonData.data()), jsonData.size()},
+            buildPart
+        )};
     }
 
-    
+    json["verified"] = meta.verified;
+    json["owner"] = meta.owner;
+
+    // repack plot data
+    return {Plot::makePlotData(json, buildPart)};
 }
 
 asio::awaitable<void> DChunk::uploadImages(const std::shared_ptr<CFAsyncClient> cfCli) const {
@@ -140,7 +191,8 @@ asio::awaitable<void> DChunk::uploadImages(const std::shared_ptr<CFAsyncClient>
         });
     }
     
-    const auto results = co_await cfCli->putManyR2Objects(std::move(requests));
+    // images aren't on the critical path, let chunk reads and writes go first
+    const auto results = co_await cfCli->putManyR2Objects(std::move(requests), requestContext(RequestScheduler::Priority::Low));
     for (const auto& res : results)
         if (res.err)
             throw std::runtime_error(res.errMsg);
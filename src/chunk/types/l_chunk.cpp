@@ -4,20 +4,321 @@
 #include <iostream>
 #include <random>
 #include <numeric>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+#include <array>
 
+#include <opencv2/core.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/awaitable.hpp>
 #include <boost/asio/stream_file.hpp>
+#include <fmt/format.h>
 
 #include "config/config.hpp"
 #include "chunk/types/l_chunk.hpp"
 #include "chunk/chunk.hpp"
 #include "utils/color_lib.hpp"
+#include "utils/splicer.hpp"
 
 constexpr size_t PC_ENCODED_HEADER_ENTRY_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
 constexpr size_t VEC3F_SIZE = sizeof(float) * 3;
 constexpr size_t COLOR_IDX_SIZE = sizeof(uint16_t);
 
+// point cloud payload layouts, in the layout nibble of the object header
+// 0: | total entries | total points | header: [id,len] | points (float xyz) | color indices |
+// 1: | total entries | total points | header: [id,len,min xyz,max xyz] | per entry x[], y[], z[] | per entry color deltas |
+// layout 1 stores positions as 16 bit fixed point between the entry's bounds, colors are sorted
+// and delta coded so the zstd envelope does the entropy coding
+constexpr uint8_t PC_LAYOUT_FLOAT = 0;
+constexpr uint8_t PC_LAYOUT_QUANTIZED = 1;
+constexpr size_t PC_QUANTIZED_HEADER_ENTRY_SIZE = PC_ENCODED_HEADER_ENTRY_SIZE + 2 * VEC3F_SIZE;
+constexpr size_t QVEC3_SIZE = sizeof(uint16_t) * 3;
+constexpr float QUANT_STEPS = 65535.f;
+
+// one axis of an entry, a plain multiply-add per point
+static void dequantize(const uint8_t* src, std::span<float> out, float min, float max) {
+    const float step = (max - min) / QUANT_STEPS;
+    for (size_t i = 0; i < out.size(); ++i) {
+        uint16_t q;
+        std::memcpy(&q, src + i * sizeof(uint16_t), sizeof(uint16_t));
+        out[i] = min + static_cast<float>(q) * step;
+    }
+}
+
+// entry and point counts from the payload header
+static std::pair<uint32_t, uint32_t> pointCloudTotals(std::span<const uint8_t> payload) {
+    if (payload.size() < 2*sizeof(uint32_t))
+        throw std::runtime_error("Point cloud is smaller than its header");
+    uint32_t totalEntries, totalPoints;
+    std::memcpy(&totalEntries, payload.data(), sizeof(uint32_t));
+    std::memcpy(&totalPoints, payload.data() + sizeof(uint32_t), sizeof(uint32_t));
+    return {totalEntries, totalPoints};
+}
+
+// calls fn(entry, bounds) for every entry of a decoded point cloud object, bounds are only read
+// for the quantized layout
+template<typename Fn>
+static void forEachPointCloud(const Codec::Decoded& decoded, Fn&& fn) {
+    const auto payload = decoded.payload;
+    const auto [totalEntries, totalPoints] = pointCloudTotals(payload);
+    const uint8_t* headerPtr = payload.data() + 2*sizeof(uint32_t);
+
+    if (decoded.layout != PC_LAYOUT_FLOAT && decoded.layout != PC_LAYOUT_QUANTIZED)
+        throw std::runtime_error(fmt::format("Unknown point cloud layout {}", decoded.layout));
+    const bool quantized = decoded.layout == PC_LAYOUT_QUANTIZED;
+    const size_t entrySize = quantized ? PC_QUANTIZED_HEADER_ENTRY_SIZE : PC_ENCODED_HEADER_ENTRY_SIZE;
+    const size_t pointSize = quantized ? QVEC3_SIZE : VEC3F_SIZE;
+    if (2*sizeof(uint32_t) + size_t(totalEntries)*entrySize + size_t(totalPoints)*(pointSize + COLOR_IDX_SIZE) > payload.size())
+        throw std::runtime_error("Point cloud is truncated");
+
+    const uint8_t* pntptr = headerPtr + totalEntries*entrySize;
+    const uint8_t* colptr = pntptr + totalPoints*pointSize;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < totalEntries; ++i) {
+        SerializedPointCloud entry{0, 0, headerPtr, pntptr, colptr};
+        std::memcpy(&entry.id, headerPtr, sizeof(uint64_t));
+        headerPtr += sizeof(uint64_t);
+        std::memcpy(&entry.count, headerPtr, sizeof(uint32_t));
+        headerPtr += sizeof(uint32_t);
+        seen += entry.count;
+        if (seen > totalPoints)
+            throw std::runtime_error("Point cloud entries exceed its point count");
+        float bounds[6]{};
+        if (quantized) {
+            std::memcpy(bounds, headerPtr, 2 * VEC3F_SIZE);
+            headerPtr += 2 * VEC3F_SIZE;
+        }
+
+        fn(entry, bounds);
+
+        pntptr += entry.count * pointSize;
+        colptr += entry.count * COLOR_IDX_SIZE;
+    }
+}
+
+// adds every entry of a decoded point cloud object wanted(id) accepts to out
+template<typename Wanted>
+static void decodePointClouds(const Codec::Decoded& decoded, Wanted&& wanted, PointCloudStore& out) {
+    const auto [totalEntries, totalPoints] = pointCloudTotals(decoded.payload);
+    out.reserve(out.size() + totalEntries, out.points() + totalPoints);
+
+    const bool quantized = decoded.layout == PC_LAYOUT_QUANTIZED;
+    forEachPointCloud(decoded, [&](const SerializedPointCloud& s, const float* bounds) {
+        if (!wanted(s.id))
+            return;
+        const uint32_t n = s.count;
+        const auto e = out.add(s.id, n);
+        const auto colidxs = out.colors(e);
+
+        if (quantized) {
+            for (size_t j = 0; j < 3; ++j)
+                dequantize(s.points + j * n * sizeof(uint16_t), out.axis(e, j), bounds[j], bounds[3 + j]);
+            // undo the delta coding
+            uint16_t colidx = 0;
+            for (uint32_t j = 0; j < n; ++j) {
+                uint16_t delta;
+                std::memcpy(&delta, s.colors + j*COLOR_IDX_SIZE, COLOR_IDX_SIZE);
+                colidx += delta;
+                colidxs[j] = colidx;
+            }
+            return;
+        }
+
+        // interleaved rows into the axes
+        const auto x = out.x(e), y = out.y(e), z = out.z(e);
+        for (uint32_t j = 0; j < n; ++j) {
+            float p[3];
+            std::memcpy(p, s.points + j * VEC3F_SIZE, VEC3F_SIZE);
+            x[j] = p[0];
+            y[j] = p[1];
+            z[j] = p[2];
+        }
+        std::memcpy(colidxs.data(), s.colors, n * COLOR_IDX_SIZE);
+    });
+}
+
+// a random sample of perc of the points of every entry of a decoded point cloud object, at
+// least 2 when there are that many, as entry id of out. points are picked by their position
+// across all entries and read straight from the serialized entries
+static void samplePointClouds(const Codec::Decoded& decoded, uint64_t id, float perc, PointCloudStore& out) {
+    struct Source {
+        SerializedPointCloud entry;
+        std::array<float, 6> bounds;
+        uint32_t end; // prefix sum of the counts
+    };
+    std::vector<Source> sources;
+    sources.reserve(pointCloudTotals(decoded.payload).first);
+    uint32_t total = 0;
+    forEachPointCloud(decoded, [&](const SerializedPointCloud& s, const float* bounds) {
+        if (s.count == 0)
+            return;
+        total += s.count;
+        sources.push_back({s, {}, total});
+        std::copy_n(bounds, 6, sources.back().bounds.begin());
+    });
+
+    const size_t k = std::min<size_t>(total, std::max<size_t>(2, static_cast<size_t>(static_cast<float>(total) * perc)));
+    std::vector<uint32_t> picks;
+    picks.reserve(k);
+    {
+        // floyd's algorithm, k distinct positions below total. sorted so entries are walked once
+        std::mt19937 rng(std::random_device{}());
+        std::unordered_set<uint32_t> chosen;
+        chosen.reserve(k);
+        for (uint32_t t = total - k; t < total; ++t) {
+            const uint32_t r = std::uniform_int_distribution<uint32_t>(0, t)(rng);
+            const uint32_t pick = chosen.insert(r).second ? r : t;
+            chosen.insert(pick);
+            picks.push_back(pick);
+        }
+        std::ranges::sort(picks);
+    }
+
+    const auto e = out.add(id, k);
+    const auto colidxs = out.colors(e);
+    const bool quantized = decoded.layout == PC_LAYOUT_QUANTIZED;
+    size_t src = 0;
+    uint32_t decodedColors = 0; // colors of the current entry summed so far
+    uint16_t colidx = 0;
+    for (size_t i = 0; i < k; ++i) {
+        while (sources[src].end <= picks[i]) {
+            ++src;
+            decodedColors = 0;
+            colidx = 0;
+        }
+        const auto& [s, bounds, end] = sources[src];
+        const uint32_t j = picks[i] - (end - s.count);
+
+        if (quantized) {
+            for (size_t a = 0; a < 3; ++a)
+                dequantize(s.points + (a * s.count + j) * sizeof(uint16_t), out.axis(e, a).subspan(i, 1), bounds[a], bounds[3 + a]);
+            // colors are delta coded within the entry
+            for (; decodedColors <= j; ++decodedColors) {
+                uint16_t delta;
+                std::memcpy(&delta, s.colors + decodedColors * COLOR_IDX_SIZE, COLOR_IDX_SIZE);
+                colidx += delta;
+            }
+            colidxs[i] = colidx;
+            continue;
+        }
+
+        float p[3];
+        std::memcpy(p, s.points + j * VEC3F_SIZE, VEC3F_SIZE);
+        out.x(e)[i] = p[0];
+        out.y(e)[i] = p[1];
+        out.z(e)[i] = p[2];
+        std::memcpy(&colidxs[i], s.colors + j * COLOR_IDX_SIZE, COLOR_IDX_SIZE);
+    }
+}
+
+// box part layouts, in the layout nibble of the chunk object
+// 0: per box min xyz, max xyz, rgb as floats
+// 1: per box min xyz, max xyz as 16 bit fixed point between the chunk bounds, rgb as 8 bit,
+//    the bounds are part BOUNDS_PART_ID. empty clusters are left out
+constexpr uint8_t BOX_LAYOUT_FLOAT = 0;
+constexpr uint8_t BOX_LAYOUT_COMPACT = 1;
+constexpr size_t BOX_FLOATS = 9;
+constexpr size_t BOX_SIZE = BOX_FLOATS * sizeof(float);
+constexpr size_t COMPACT_BOX_SIZE = 6 * sizeof(uint16_t) + 3;
+constexpr float COLOR_STEPS = 255.f;
+
+using Bounds = std::array<float, 6>; // min xyz, max xyz
+
+static Bounds readBounds(std::span<const uint8_t> part) {
+    Bounds bounds;
+    if (part.size() != sizeof(Bounds))
+        throw std::runtime_error("Chunk bounds part is malformed");
+    std::memcpy(bounds.data(), part.data(), sizeof(Bounds));
+    return bounds;
+}
+
+static std::vector<float> decodeBoxPart(std::span<const uint8_t> part, uint8_t layout, const Bounds& bounds) {
+    if (layout == BOX_LAYOUT_FLOAT) {
+        if (part.size() % BOX_SIZE != 0)
+            throw std::runtime_error("Box part is malformed");
+        std::vector<float> boxes(part.size() / sizeof(float));
+        std::memcpy(boxes.data(), part.data(), part.size());
+        return boxes;
+    }
+    if (layout != BOX_LAYOUT_COMPACT)
+        throw std::runtime_error(fmt::format("Unknown box layout {}", layout));
+    if (part.size() % COMPACT_BOX_SIZE != 0)
+        throw std::runtime_error("Box part is malformed");
+
+    const size_t k = part.size() / COMPACT_BOX_SIZE;
+    std::vector<float> boxes(k * BOX_FLOATS);
+    float step[3];
+    for (size_t j = 0; j < 3; ++j)
+        step[j] = (bounds[3 + j] - bounds[j]) / QUANT_STEPS;
+    for (size_t i = 0; i < k; ++i) {
+        const uint8_t* src = part.data() + i * COMPACT_BOX_SIZE;
+        float* box = boxes.data() + i * BOX_FLOATS;
+        uint16_t q[6];
+        std::memcpy(q, src, sizeof(q));
+        for (size_t j = 0; j < 6; ++j)
+            box[j] = bounds[j % 3] + static_cast<float>(q[j]) * step[j % 3];
+        for (size_t j = 0; j < 3; ++j)
+            box[6 + j] = static_cast<float>(src[sizeof(q) + j]) / COLOR_STEPS;
+    }
+    return boxes;
+}
+
+static std::vector<uint8_t> encodeBoxPart(std::span<const float> boxes, uint8_t layout, const Bounds& bounds) {
+    const size_t k = boxes.size() / BOX_FLOATS;
+    if (layout == BOX_LAYOUT_FLOAT) {
+        std::vector<uint8_t> buf(k * BOX_SIZE);
+        std::memcpy(buf.data(), boxes.data(), buf.size());
+        return buf;
+    }
+
+    float scale[3];
+    for (size_t j = 0; j < 3; ++j) {
+        const float range = bounds[3 + j] - bounds[j];
+        scale[j] = range > 0.f ? QUANT_STEPS / range : 0.f;
+    }
+    std::vector<uint8_t> buf(k * COMPACT_BOX_SIZE);
+    uint8_t* dst = buf.data();
+    for (size_t i = 0; i < k; ++i) {
+        const float* box = boxes.data() + i * BOX_FLOATS;
+        if (std::all_of(box, box + BOX_FLOATS, [](float v) { return v == 0.f; }))
+            continue;
+
+        for (size_t j = 0; j < 6; ++j) {
+            const float v = (box[j] - bounds[j % 3]) * scale[j % 3];
+            const uint16_t q = static_cast<uint16_t>(std::lround(std::clamp(v, 0.f, QUANT_STEPS)));
+            std::memcpy(dst + j * sizeof(uint16_t), &q, sizeof(uint16_t));
+        }
+        for (size_t j = 0; j < 3; ++j)
+            dst[6 * sizeof(uint16_t) + j] = static_cast<uint8_t>(std::lround(std::clamp(box[6 + j], 0.f, 1.f) * COLOR_STEPS));
+        dst += COMPACT_BOX_SIZE;
+    }
+    buf.resize(dst - buf.data());
+    return buf;
+}
+
+// grows bounds to hold every box
+static void extendBounds(Bounds& bounds, bool& empty, std::span<const float> boxes) {
+    for (size_t i = 0; i + BOX_FLOATS <= boxes.size(); i += BOX_FLOATS) {
+        const float* box = boxes.data() + i;
+        if (std::all_of(box, box + BOX_FLOATS, [](float v) { return v == 0.f; }))
+            continue;
+        for (size_t j = 0; j < 3; ++j) {
+            bounds[j] = empty ? box[j] : std::min(bounds[j], box[j]);
+            bounds[3 + j] = empty ? box[3 + j] : std::max(bounds[3 + j], box[3 + j]);
+        }
+        empty = false;
+    }
+}
+
+std::vector<float> LChunk::decodeBoxes(const PartStore& parts, uint64_t id) {
+    Bounds bounds{};
+    if (parts.layout() == BOX_LAYOUT_COMPACT)
+        bounds = readBounds(parts.get(BOUNDS_PART_ID));
+    return decodeBoxPart(parts.get(id), parts.layout(), bounds);
+}
+
 asio::awaitable<void> LChunk::prep(const std::shared_ptr<CFAsyncClient> cfCli) {
     co_await downloadParts(cfCli);
     co_await downloadPointCloud(cfCli);
@@ -35,7 +336,7 @@ asio::awaitable<void> LChunk::prep(const std::shared_ptr<CFAsyncClient> cfCli) {
                 true // use cache
             });
         
-        updates = co_await cfCli->getManyR2Objects(std::move(requests));
+        updates = co_await cfCli->getManyR2Objects(std::move(requests), requestContext(RequestScheduler::Priority::Critical));
     }
     // sample updated point clouds
     for (size_t i = 0; i < updates.size(); ++i) {
@@ -43,43 +344,8 @@ asio::awaitable<void> LChunk::prep(const std::shared_ptr<CFAsyncClient> cfCli) {
         if (obj.err)
             throw std::runtime_error(obj.errMsg);
 
-        uint8_t* headerPtr = obj.body.data() + 2;
-        uint32_t totalEntries, totalPoints;
-        std::memcpy(&totalEntries, headerPtr, sizeof(uint32_t));
-        headerPtr += sizeof(uint32_t);
-        std::memcpy(&totalPoints, headerPtr, sizeof(uint32_t));
-        headerPtr += sizeof(uint32_t);
-        
-        // shuffle indices for random sample
-        std::vector<int> idx(totalPoints);
-        std::iota(idx.begin(), idx.end(), 0);
-        std::mt19937 rng(std::random_device{}());
-        std::shuffle(idx.begin(), idx.end(), rng);
-        
-        // create matrix
-        const size_t k = std::max(2ul, static_cast<size_t>(static_cast<float>(totalPoints) * VARS::PC_SAMPLE_PERC));
-        cv::Mat points(k, 3, CV_32F);
-        std::vector<uint16_t> colors(k);
-         
-        uint8_t* pntptr = headerPtr + totalEntries*PC_ENCODED_HEADER_ENTRY_SIZE;
-        uint8_t* colptr = pntptr + totalPoints*VEC3F_SIZE;
-
-        for (size_t j = 0; j < k; ++j) {
-            // copy point
-            std::memcpy(
-                points.ptr<float>(j),
-                pntptr + idx[j]*VEC3F_SIZE,
-                sizeof(float) * 3
-            );
-            // copy color idx
-            std::memcpy(
-                &colors[j],
-                colptr + idx[j]*COLOR_IDX_SIZE,
-                sizeof(uint16_t)
-            );
-        }
-
-        _pointClouds[_needsUpdate[i]] = PointCloud{std::move(points), std::move(colors)};
+        const auto decoded = co_await decode(obj.body);
+        samplePointClouds(decoded, _needsUpdate[i], VARS::PC_SAMPLE_PERC, _pointClouds);
     }
     // save updated point cloud (not modified from here)
     co_await uploadPointCloud(cfCli);
@@ -88,30 +354,29 @@ asio::awaitable<void> LChunk::prep(const std::shared_ptr<CFAsyncClient> cfCli) {
 void LChunk::process(){
 
     // compute low-resolution representations of the chunk
+    std::vector<std::pair<uint64_t, std::vector<float>>> updated;
+    std::vector<float> norm; // kmeans rows, reused across entries
+    std::vector<cv::Vec3f> mean, m2, color;
+    std::vector<float> count;
     for (const auto& id : _needsUpdate) {
 
-        const PointCloud& pointCloud = _pointClouds[id];
-        const cv::Mat& pnts = pointCloud.points;
-        const size_t n = pnts.rows;
-
-        if(pnts.rows < 2)
+        const auto* entry = _pointClouds.find(id);
+        if (!entry || entry->count < 2)
             continue;
-
-        // compute bounds of point cloud
-        cv::Mat min, max;
-        cv::reduce(pnts, min, 0, cv::REDUCE_MIN);
-        cv::reduce(pnts, max, 0, cv::REDUCE_MAX);
-
-        // normalize points
-        cv::Mat pntsNorm = pnts.clone();
-        for (int i = 0; i < 3; ++i) {
-            float m = min.at<float>(0,i);
-            float r = max.at<float>(0,i) - m;
-            if (r > 1e-6f) {
-                pntsNorm.col(i) -= m;
-                pntsNorm.col(i) /= r;
-            }
+        const auto e = *entry;
+        const size_t n = e.count;
+        const auto colidxs = _pointClouds.colors(e);
+
+        // normalize points by the bounds of the point cloud
+        norm.resize(3*n);
+        for (size_t j = 0; j < 3; ++j) {
+            const auto axis = _pointClouds.axis(e, j);
+            const auto [m, M] = std::ranges::minmax(axis);
+            const float r = M - m;
+            for (size_t i = 0; i < n; ++i)
+                norm[3*i + j] = r > 1e-6f ? (axis[i] - m) / r : axis[i];
         }
+        cv::Mat pntsNorm(n, 3, CV_32F, norm.data());
 
         // number of boxes = log4(n+1)+1
         size_t k = static_cast<size_t>(std::log(static_cast<double>(n) + 1.) / 2.) + 1;
@@ -126,15 +391,18 @@ void LChunk::process(){
             ), 1, cv::KMEANS_PP_CENTERS, centers
         );
 
-        // compute bounding boxes, encode into uint8 buffer
-        std::vector<cv::Vec3f> mean(k, {0,0,0}), m2(k, {0,0,0}), color(k, {0,0,0});
-        std::vector<float> count(k, 0);
+        // compute bounding boxes
+        mean.assign(k, {0,0,0});
+        m2.assign(k, {0,0,0});
+        color.assign(k, {0,0,0});
+        count.assign(k, 0);
+        const auto xs = _pointClouds.x(e), ys = _pointClouds.y(e), zs = _pointClouds.z(e);
         for (size_t i = 0; i < n; ++i) {
             size_t cl = labels.at<int>(i);
-            const float* p = pnts.ptr<float>(i);
+            const float p[3]{xs[i], ys[i], zs[i]};
             count[cl] += 1.0f;
 
-            cv::Vec3f col = *ColorLib::getColorAsVec(pointCloud.colidxs[i]);
+            cv::Vec3f col = *ColorLib::getColorAsVec(colidxs[i]);
 
             for (size_t j = 0; j < 3; ++j) {
                 float x = p[j];
@@ -146,8 +414,8 @@ void LChunk::process(){
             }   
         }
 
-        // encode boxes into buffer
-        std::vector<uint8_t> buf(9*k*sizeof(float));
+        // boxes as floats, encoded below once the chunk bounds are known
+        std::vector<float> boxes(BOX_FLOATS*k);
         for (size_t i = 0; i < k; ++i) {
             const float clusterSize = count[i];
             if (clusterSize == 0)
@@ -163,11 +431,62 @@ void LChunk::process(){
                 color[i][0] / clusterSize, color[i][1] / clusterSize, color[i][2] / clusterSize,
             };
 
-            std::memcpy(buf.data() + i*9*sizeof(float), &arr[0], sizeof(float)*9);
+            std::memcpy(boxes.data() + i*BOX_FLOATS, &arr[0], BOX_SIZE);
         }
 
-        _parts[id] = std::move(buf);
+        updated.emplace_back(id, std::move(boxes));
+    }
+
+    // compact boxes are quantized to the chunk bounds. the bounds only grow, so kept parts are
+    // only requantized when the chunk grows or the layout changes
+    const uint8_t layout = CONFIG::COMPACT_BOXES ? BOX_LAYOUT_COMPACT : BOX_LAYOUT_FLOAT;
+    const bool wasCompact = _parts.layout() == BOX_LAYOUT_COMPACT;
+    Bounds bounds{};
+    bool empty = true;
+    if (wasCompact) {
+        bounds = readBounds(_parts.get(BOUNDS_PART_ID));
+        empty = false;
     }
+    const Bounds oldBounds = bounds;
+
+    std::unordered_set<uint64_t> fresh;
+    for (const auto& [id, boxes] : updated) {
+        fresh.insert(id);
+        extendBounds(bounds, empty, boxes);
+    }
+    if (layout == BOX_LAYOUT_COMPACT && !wasCompact)
+        for (const auto& e : _parts)
+            if (e.id != BOUNDS_PART_ID && !fresh.contains(e.id))
+                extendBounds(bounds, empty, decodeBoxPart(e.data, _parts.layout(), oldBounds));
+
+    // sides that grow get headroom, so updates rarely move the bounds and usually rewrite only
+    // their own parts. kept boxes are requantized from their decoded values, which only loses
+    // precision on axes that grew. each growth widens the axis by the headroom at least, so the
+    // steps grow geometrically and the error adds up to (1 + h) / h half steps of the last grid
+    if (layout == BOX_LAYOUT_COMPACT && bounds != oldBounds)
+        for (size_t j = 0; j < 3; ++j) {
+            const float pad = (bounds[3 + j] - bounds[j]) * CONFIG::COMPACT_BOXES_HEADROOM;
+            if (!wasCompact || bounds[j] < oldBounds[j])
+                bounds[j] -= pad;
+            if (!wasCompact || bounds[3 + j] > oldBounds[3 + j])
+                bounds[3 + j] += pad;
+        }
+
+    const bool requantize = _parts.layout() != layout || (layout == BOX_LAYOUT_COMPACT && bounds != oldBounds);
+    if (requantize)
+        for (const auto& e : _parts)
+            if (e.id != BOUNDS_PART_ID && !fresh.contains(e.id))
+                updated.emplace_back(e.id, decodeBoxPart(e.data, _parts.layout(), oldBounds));
+
+    for (const auto& [id, boxes] : updated)
+        _parts.set(id, encodeBoxPart(boxes, layout, bounds));
+    if (layout == BOX_LAYOUT_COMPACT && (!wasCompact || bounds != oldBounds)) {
+        std::vector<uint8_t> buf(sizeof(Bounds));
+        std::memcpy(buf.data(), bounds.data(), sizeof(Bounds));
+        _parts.set(BOUNDS_PART_ID, std::move(buf));
+    } else if (layout != BOX_LAYOUT_COMPACT)
+        _parts.erase(BOUNDS_PART_ID);
+    _parts.setLayout(layout);
 
 }
 
@@ -185,108 +504,170 @@ asio::awaitable<std::optional<std::string>> LChunk::update(const std::shared_ptr
 
 boost::asio::awaitable<void> LChunk::downloadPointCloud(const std::shared_ptr<CFAsyncClient> cfCli) {
     // get object with cache
-    auto obj = co_await cfCli->getR2Object(VARS::CF_POINT_CLOUDS_BUCKET, _chunkId, true); 
+    auto obj = co_await cfCli->getR2Object(
+        VARS::CF_POINT_CLOUDS_BUCKET, 
+        _chunkId, 
+        true, 
+        requestContext(RequestScheduler::Priority::Critical)
+    ); 
     if (obj.err) {
         if (obj.errType != Aws::S3::S3Errors::NO_SUCH_KEY)
             throw std::runtime_error(obj.errMsg);
         co_return;
     }
 
-    // format: | total entries | total points | header: [id,len] | points | color indices
-    uint8_t* headerPtr = obj.body.data() + 2;
-    uint32_t totalEntries, totalPoints;
-    std::memcpy(&totalEntries, headerPtr, sizeof(uint32_t));
-    headerPtr += sizeof(uint32_t);
-    std::memcpy(&totalPoints, headerPtr, sizeof(uint32_t));
-    headerPtr += sizeof(uint32_t);
-
-    uint8_t* pntptr = headerPtr + totalEntries*PC_ENCODED_HEADER_ENTRY_SIZE;
-    uint8_t* colptr = pntptr + totalPoints*VEC3F_SIZE;
-    
     // only keep parts that do not need update
     std::unordered_set<uint64_t> nuSet(_needsUpdate.begin(), _needsUpdate.end());
+    auto decoded = co_await decode(obj.body);
 
-    for (size_t i = 0; i < totalEntries; ++i) {
-        uint64_t id;
-        std::memcpy(&id, headerPtr, sizeof(uint64_t));
-        headerPtr += sizeof(uint64_t);
-        uint32_t n;
-        std::memcpy(&n, headerPtr, sizeof(uint32_t));
-        headerPtr += sizeof(uint32_t);
-
-        // TODO skip if item in needs update
-        if(!nuSet.contains(id)) {
-            // create matrix
-            cv::Mat points(n, 3, CV_32F);
-            std::vector<uint16_t> colidxs(n);
-
-            std::memcpy(points.data, pntptr, n * VEC3F_SIZE);
-            std::memcpy(colidxs.data(), colptr, n * COLOR_IDX_SIZE);
-
-            _pointClouds[id] = PointCloud{std::move(points), std::move(colidxs)};
-        }
-
-        pntptr += n * VEC3F_SIZE;
-        colptr += n * COLOR_IDX_SIZE;
-    }    
+    // in the layout uploads write, kept entries stay serialized and are copied as they are
+    const uint8_t layout = CONFIG::QUANTIZE_POINT_CLOUDS ? PC_LAYOUT_QUANTIZED : PC_LAYOUT_FLOAT;
+    if (decoded.layout != layout) {
+        decodePointClouds(decoded, [&](uint64_t id) { return !nuSet.contains(id); }, _pointClouds);
+        co_return;
+    }
+    _storedPointClouds.reserve(pointCloudTotals(decoded.payload).first);
+    forEachPointCloud(decoded, [&](const SerializedPointCloud& entry, const float*) {
+        if (!nuSet.contains(entry.id))
+            _storedPointClouds.push_back(entry);
+    });
+    // the payload of a compressed object is in decoded.owned, moving it keeps the buffer
+    if (decoded.owned.empty())
+        _storedPointCloudsOwner = obj.owner;
+    else
+        _storedPointCloudsOwner = std::make_shared<const std::vector<uint8_t>>(std::move(decoded.owned));
 }
 
 boost::asio::awaitable<void> LChunk::uploadPointCloud(const std::shared_ptr<CFAsyncClient> cfCli) const {
-    if (_pointClouds.size() == 0)
+    if (!hasPointClouds())
         co_return;
 
-    uint32_t totalEntries = _pointClouds.size();
+    // stored entries rewritten by this update are left out
+    std::vector<SerializedPointCloud> kept;
+    kept.reserve(_storedPointClouds.size());
+    uint32_t keptPoints = 0;
+    for (const auto& entry : _storedPointClouds)
+        if (!_pointClouds.contains(entry.id)) {
+            kept.push_back(entry);
+            keptPoints += entry.count;
+        }
+
+    uint32_t totalEntries = kept.size() + _pointClouds.size();
 
     assert(totalEntries > 0 && "Point cloud must have at least one entry");
 
-    uint32_t totalPoints = 0;
-    for (const auto& [_, pointCloud] : _pointClouds)
-        totalPoints += pointCloud.points.rows;
+    uint32_t totalPoints = keptPoints + _pointClouds.points();
 
     assert(totalPoints > 1 && "Point cloud must have at least 2 points");
 
+    const uint8_t layout = CONFIG::QUANTIZE_POINT_CLOUDS ? PC_LAYOUT_QUANTIZED : PC_LAYOUT_FLOAT;
+    const size_t entrySize = layout == PC_LAYOUT_QUANTIZED ? PC_QUANTIZED_HEADER_ENTRY_SIZE : PC_ENCODED_HEADER_ENTRY_SIZE;
+    const size_t pointSize = layout == PC_LAYOUT_QUANTIZED ? QVEC3_SIZE : VEC3F_SIZE;
+
     // allocate buffer, write len prefixes
-    std::vector<uint8_t> buf(2 + 2*sizeof(uint32_t) + totalEntries*PC_ENCODED_HEADER_ENTRY_SIZE + totalPoints*(VEC3F_SIZE + COLOR_IDX_SIZE));
-    buf[0] = buf[1] = 0;
+    std::vector<uint8_t> buf(Codec::HEADER_SIZE + 2*sizeof(uint32_t) + totalEntries*entrySize + totalPoints*(pointSize + COLOR_IDX_SIZE));
 
-    uint8_t* headptr = buf.data() + 2;
+    uint8_t* headptr = buf.data() + Codec::HEADER_SIZE;
     std::memcpy(headptr, &totalEntries, sizeof(uint32_t));
     headptr += sizeof(uint32_t);
     std::memcpy(headptr, &totalPoints, sizeof(uint32_t));
     headptr += sizeof(uint32_t);
 
-    uint8_t* pntptr = headptr + totalEntries*PC_ENCODED_HEADER_ENTRY_SIZE;
-    uint8_t* colptr = pntptr + totalPoints*VEC3F_SIZE;
+    uint8_t* pntptr = headptr + totalEntries*entrySize;
+    uint8_t* colptr = pntptr + totalPoints*pointSize;
+
+    // kept entries first, neighbours in the old object move with one copy per region
+    {
+        Splicer headers(headptr), points(pntptr), colors(colptr);
+        for (const auto& entry : kept) {
+            headers.splice(entry.header, entrySize);
+            points.splice(entry.points, entry.count * pointSize);
+            colors.splice(entry.colors, entry.count * COLOR_IDX_SIZE);
+        }
+        headers.flush();
+        points.flush();
+        colors.flush();
+        headptr += kept.size() * entrySize;
+        pntptr += keptPoints * pointSize;
+        colptr += keptPoints * COLOR_IDX_SIZE;
+    }
 
     // write data
-    for (const auto& [id, pointCloud] : _pointClouds) {
-        std::memcpy(headptr, &id, sizeof(uint64_t));
+    std::vector<uint32_t> order;
+    for (const auto& e : _pointClouds) {
+        std::memcpy(headptr, &e.id, sizeof(uint64_t));
         headptr += sizeof(uint64_t);
-        uint32_t n = pointCloud.points.rows;
+        uint32_t n = e.count;
         std::memcpy(headptr, &n, sizeof(uint32_t));
         headptr += sizeof(uint32_t);
+        const auto colidxs = _pointClouds.colors(e);
 
-        std::memcpy(
-            pntptr, 
-            pointCloud.points.data, 
-            n * VEC3F_SIZE
-        );
-        std::memcpy(
-            colptr,
-            pointCloud.colidxs.data(),
-            n * COLOR_IDX_SIZE
-        );
-        pntptr += n * VEC3F_SIZE;
+        if (layout == PC_LAYOUT_FLOAT) {
+            const auto x = _pointClouds.x(e), y = _pointClouds.y(e), z = _pointClouds.z(e);
+            for (uint32_t i = 0; i < n; ++i) {
+                const float p[3]{x[i], y[i], z[i]};
+                std::memcpy(pntptr + i * VEC3F_SIZE, p, VEC3F_SIZE);
+            }
+            std::memcpy(
+                colptr,
+                colidxs.data(),
+                n * COLOR_IDX_SIZE
+            );
+            pntptr += n * VEC3F_SIZE;
+            colptr += n * COLOR_IDX_SIZE;
+            continue;
+        }
+
+        // bounds of the entry, points are quantized between them
+        float min[3]{0, 0, 0}, max[3]{0, 0, 0};
+        if (n > 0)
+            for (size_t j = 0; j < 3; ++j) {
+                const auto [lo, hi] = std::ranges::minmax(_pointClouds.axis(e, j));
+                min[j] = lo;
+                max[j] = hi;
+            }
+        std::memcpy(headptr, min, VEC3F_SIZE);
+        std::memcpy(headptr + VEC3F_SIZE, max, VEC3F_SIZE);
+        headptr += 2 * VEC3F_SIZE;
+
+        // point order doesn't matter, sorting by color makes most deltas zero
+        order.resize(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, {}, [&](uint32_t i) { return colidxs[i]; });
+
+        for (size_t j = 0; j < 3; ++j) {
+            const auto axis = _pointClouds.axis(e, j);
+            const float range = max[j] - min[j];
+            const float scale = range > 0.f ? QUANT_STEPS / range : 0.f;
+            for (uint32_t i = 0; i < n; ++i) {
+                const float v = (axis[order[i]] - min[j]) * scale;
+                const uint16_t q = static_cast<uint16_t>(std::lround(std::clamp(v, 0.f, QUANT_STEPS)));
+                std::memcpy(pntptr + (j*n + i) * sizeof(uint16_t), &q, sizeof(uint16_t));
+            }
+        }
+        uint16_t prev = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            const uint16_t colidx = colidxs[order[i]];
+            const uint16_t delta = colidx - prev;
+            std::memcpy(colptr + i * COLOR_IDX_SIZE, &delta, COLOR_IDX_SIZE);
+            prev = colidx;
+        }
+        pntptr += n * QVEC3_SIZE;
         colptr += n * COLOR_IDX_SIZE;
     }
 
+    buf = co_await encode(std::move(buf), CONFIG::COMPRESS_POINT_CLOUDS, VARS::CF_POINT_CLOUDS_BUCKET, layout);
+
     const auto layer = Chunk::parseIdStr(_chunkId).first;
+    const bool writeBack = Chunk::writeBack(_chunkId);
     auto out = co_await cfCli->putR2Object(
         VARS::CF_POINT_CLOUDS_BUCKET,
         _chunkId,
         "application/octet-stream",
         std::move(buf),
-        layer != 0 // write to cache
+        layer != 0 || writeBack, // write to cache, write-back needs the cached copy
+        requestContext(RequestScheduler::Priority::Critical),
+        writeBack
     );
     if (out.err)
         throw std::runtime_error(out.errMsg);
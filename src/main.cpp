@@ -29,12 +29,16 @@
 #include "chunk/types/d_chunk.hpp"
 #include "chunk/types/l_chunk.hpp"
 #include "async/cf_async_client.hpp"
+#include "async/s3_object_store.hpp"
+#include "async/local_object_store.hpp"
 #include "utils/plot.hpp"
+#include "utils/update_flags_adapter.hpp"
 #include "utils/utils.hpp"
 #include "utils/redis_pool.hpp"
+#include "utils/redis_keys.hpp"
 #include "async/async_semaphore.hpp"
+#include "async/purge_engine.hpp"
 #include "utils/delayed_updates.hpp"
-#include "utils/unique_queue.hpp"
 
 namespace redis = boost::redis;
 namespace asio = boost::asio;
@@ -60,18 +64,22 @@ public:
 
 static std::atomic<bool> killFlag(false);
 static std::shared_ptr<CFAsyncClient> cfCli;
-static UniqueQueue needsPurge;
 
 asio::awaitable<void> processChunk(
     RedisPool& redisPool,
     asio::thread_pool& cpuPool,
     DelayedUpdates& delayedUpdates,
+    PurgeEngine& purgeEngine,
     AsyncSemaphore& pipelineSem,
     std::unordered_set<std::string>& inPipeline,
     const std::string chunkId
 ) {
     PipelineGuard pg(pipelineSem, inPipeline, chunkId);
 
+    // keep this job's own objects cached until it finishes
+    const auto chunkPin = cfCli->pinR2Object(VARS::CF_CHUNKS_BUCKET, chunkId);
+    const auto pointCloudPin = cfCli->pinR2Object(VARS::CF_POINT_CLOUDS_BUCKET, chunkId);
+
     try {
         // get children that need update
         std::vector<std::string> needsUpdate;
@@ -82,12 +90,12 @@ asio::awaitable<void> processChunk(
                 return m
             )";
 
-            const std::string setKey = VARS::REDIS_UPDATE_NEEDS_UPDATE_PREFIX + chunkId;
+            const std::string setKey = RedisKeys::needsUpdate(chunkId);
             redis::request req;
             req.push("EVAL", script, "1", setKey);
             
             redis::response<std::vector<std::string>> res;
-            co_await redisPool.get().async_exec(req, res, asio::use_awaitable);
+            co_await redisPool.exec(setKey, req, res);
             
             needsUpdate = std::get<0>(res).value();
             if (needsUpdate.empty()) {
@@ -101,63 +109,39 @@ asio::awaitable<void> processChunk(
 
         // if chunk is not a low-res chunk, get update flags
         if (chunkId[0] != 'l' || (chunkId[0] == 'l' && splitId.first == 2)) {
-            std::vector<std::vector<std::string>> flagSets;
+            std::vector<Plot::UpdateFlags> updateFlags;
             {
+                // flags live in one hash per chunk (plot id -> bitmask). fetch in needsUpdate order
+                // and only remove the fields being claimed, so flags for plots queued after the
+                // needs update set was popped are left for the next pass
                 static const std::string script = R"(
-                    local results = {}
-                    for i, key in ipairs(KEYS) do
-                        results[i] = redis.call('SMEMBERS', key)
+                    local f = redis.call('HMGET', KEYS[1], unpack(ARGV))
+                    redis.call('HDEL', KEYS[1], unpack(ARGV))
+                    for i = 1, #f do
+                        f[i] = tonumber(f[i]) or 0
                     end
-                    redis.call('DEL', unpack(KEYS))
-                    return results
+                    return f
                 )";
 
+                const std::string hashKey = RedisKeys::updateFlags(chunkId);
                 std::vector<std::string> args;
-                args.reserve(2 + needsUpdate.size());
+                args.reserve(3 + needsUpdate.size());
                 args.push_back(script);
-                args.push_back(std::to_string(needsUpdate.size()));
-                for (const auto& id : needsUpdate)
-                    args.push_back(VARS::REDIS_UPDATE_NEEDS_UPDATE_FLAGS_PREFIX + id);
+                args.push_back("1");
+                args.push_back(hashKey);
+                args.insert(args.end(), needsUpdate.begin(), needsUpdate.end());
 
                 redis::request req;
                 req.push_range("EVAL", args);
 
-                redis::response<std::vector<boost::redis::resp3::node>> res;
-                co_await redisPool.get().async_exec(req, res, asio::use_awaitable);
-                
-                // parse the generic_response to extract nested arrays
-                const auto& nodes = std::get<0>(res).value();
-                
-                // ok to start at i = 2 since we are sure we are passing in atleast one key to request
-                // since get needs update will return if no children to update
-                std::vector<std::string> arr;
-                for (size_t i = 2; i < nodes.size(); ++i) {
-                    auto& node = nodes[i];
-                    if (node.depth == 1 && node.data_type == redis::resp3::type::array) {
-                        // Start of a new array
-                        flagSets.push_back(std::move(arr));
-                        arr.clear();
-                    } else if (node.depth == 2 && node.data_type == redis::resp3::type::blob_string) {
-                        // String element in the current array
-                        std::cout << "node: " << std::string(node.value) << std::endl;
-                        arr.push_back(std::string(node.value));
-                    }
-                }
-                flagSets.push_back(std::move(arr));
-            }
+                // integer replies are parsed directly into Plot::UpdateFlags (see update_flags_adapter.hpp)
+                redis::response<std::vector<Plot::UpdateFlags>> res;
+                co_await redisPool.exec(hashKey, req, res);
 
-            // parse update flag strings
-            std::vector<Plot::UpdateFlags> updateFlags(needsUpdate.size());
-            for (size_t i = 0; i < flagSets.size(); ++i)
-                for (const auto& flag : flagSets[i])
-                    if (flag == VARS::REDIS_FLAG_METADATA_ONLY)
-                        updateFlags[i].metadataOnly = true;
-                    else if (flag == VARS::REDIS_FLAG_SET_DEFAULT_JSON)
-                        updateFlags[i].setDefaultJson = true;
-                    else if (flag == VARS::REDIS_FLAG_SET_DEFAULT_BUILD)
-                        updateFlags[i].setDefaultBuild = true;
-                    else if (flag == VARS::REDIS_FLAG_NO_IMAGE_UPDATE)
-                        updateFlags[i].noImageUpdate = true;
+                updateFlags = std::move(std::get<0>(res).value());
+                if (updateFlags.size() != needsUpdate.size())
+                    throw std::runtime_error("Update flag count mismatch for " + chunkId);
+            }
 
             if (splitId.first == 2)
                 chunk = std::make_unique<BaseChunk>(chunkId, std::move(needsUpdate), std::move(updateFlags));
@@ -167,6 +151,7 @@ asio::awaitable<void> processChunk(
             chunk = std::make_unique<LChunk>(chunkId, std::move(needsUpdate));
 
         // pipeline
+        chunk->setCpuExecutor(cpuPool.get_executor());
         co_await chunk->prep(cfCli);
         // process chunk on thread pool
         co_await asio::co_spawn(cpuPool.get_executor(), [&chunk]() mutable -> asio::awaitable<void> {
@@ -182,42 +167,80 @@ asio::awaitable<void> processChunk(
         }
         std::cout << chunkId << std::endl;
 
-        // schedule chunk to be purged from cloudflare cache
-        needsPurge.push(chunkId);
+        // schedule chunk to be purged from cloudflare cache, write-back chunks are purged
+        // once they are flushed
+        if (!Chunk::writeBack(chunkId))
+            purgeEngine.push(chunkId);
     } catch (const std::exception& e) {
         std::cerr << "[ex] " << e.what() << "\n";
     }
     co_return;
 }
 
-asio::awaitable<void> purgeChunks() {
-    if (needsPurge.size() == 0)
-        co_return;
-
-    const size_t n = std::min(needsPurge.size(), VARS::PURGE_URLS_LIMIT);
-    std::vector<std::string> urls;
-    urls.reserve(n);
-    
-    for (size_t i = 0; i < n; ++i) {
-        std::cout << "purging " << needsPurge.front() << std::endl;
-        urls.push_back(VARS::CF_CHUNKS_BUCKET_URL + needsPurge.front());
-        needsPurge.pop();
-    }
-
-    co_await cfCli->purgeCache(std::move(urls));
-    co_return;
-}
-
-asio::awaitable<void> purgeLoop() {
+asio::awaitable<void> statsLoop(RedisPool& redisPool, const PurgeEngine& purgeEngine) {
     const auto exec = co_await asio::this_coro::executor;
     asio::steady_timer timer(exec);
 
-    for (;;) {
+    // tick every second so shutdown isn't held up by a long timer
+    for (int64_t tick = 1;; ++tick) {
+        timer.expires_after(std::chrono::seconds(1));
+        co_await timer.async_wait(asio::use_awaitable);
         if (killFlag.load(std::memory_order_relaxed))
             break;
-        co_await purgeChunks();
-        timer.expires_after(std::chrono::milliseconds(VARS::PURGE_DELAY));
-        co_await timer.async_wait(asio::use_awaitable);
+        if (tick % CONFIG::STATS_INTERVAL_SEC != 0)
+            continue;
+
+        const auto redisStats = redisPool.stats();
+        for (size_t i = 0; i < redisStats.size(); ++i) {
+            const auto& s = redisStats[i];
+            std::cout << fmt::format(
+                "[stats] redis {} conn {}: {} outstanding, {:.2f} ms, {} requests, {} errors{}",
+                s.node, i, s.outstanding, s.latencyMs, s.requests, s.errors, s.healthy ? "" : " (unhealthy)"
+            ) << std::endl;
+        }
+
+        const auto purge = purgeEngine.stats();
+        std::cout << fmt::format(
+            "[stats] purge: {} queued, {} batches in flight (window {:.1f}), {} purged, {} failed batches, {} retried, {} dropped, {} throttled, {} coalesced",
+            purge.queued, purge.inFlight, purge.window, purge.purged, purge.failedBatches, purge.retried, purge.dropped, purge.throttled, purge.coalesced
+        ) << std::endl;
+
+        const auto r2 = cfCli->r2Stats();
+        std::cout << fmt::format(
+            "[stats] r2: {} requests, {} attempts, {} retries, {} hedged ({} won, after {:.1f} ms), {} deadline exceeded, {} failed",
+            r2.requests, r2.attempts, r2.retries, r2.hedges, r2.hedgeWins, r2.hedgeDelayMs, r2.deadlines, r2.errors
+        ) << std::endl;
+
+        const auto conns = cfCli->connectionStats();
+        if (conns.connects > 0)
+            std::cout << fmt::format(
+                "[stats] r2 connections: {} idle, {} active, {} handshakes ({} resumed, {:.1f} ms avg), {} failed, {} pings",
+                conns.idle, conns.active, conns.connects, conns.resumed, conns.connectMs / conns.connects, conns.failed, conns.pings
+            ) << std::endl;
+
+        const auto sched = cfCli->schedulerStats();
+        std::cout << fmt::format(
+            "[stats] r2 scheduler: {} in flight, queued critical {} ({} jobs), normal {} ({} jobs), low {} ({} jobs)",
+            sched.inFlight, sched.queued[0], sched.jobs[0], sched.queued[1], sched.jobs[1], sched.queued[2], sched.jobs[2]
+        ) << std::endl;
+
+        if (CONFIG::R2_WRITE_BACK) {
+            const auto wb = cfCli->writeBackStats();
+            std::cout << fmt::format(
+                "[stats] write-back: {} dirty ({} MB), {} writes, {} coalesced, {} flushes, {} flush errors",
+                wb.dirty, wb.dirtyBytes >> 20, wb.writes, wb.coalesced, wb.flushes, wb.flushErrors
+            ) << std::endl;
+        }
+
+        for (const auto& s : cfCli->cacheStats()) {
+            const auto& c = s.counters;
+            const uint64_t lookups = c.hits + c.misses;
+            std::cout << fmt::format(
+                "[stats] cache {} {}: {:.1f}% hit ({}/{}), {} evictions, {} rejected, {} entries, {} MB",
+                s.bucket, s.layer, lookups ? 100.0 * c.hits / lookups : 0.0, c.hits, lookups,
+                c.evictions, c.rejects, c.entries, c.bytes >> 20
+            ) << std::endl;
+        }
     }
     co_return;
 }
@@ -228,23 +251,44 @@ asio::awaitable<void> mainLoop() {
     // create thread pool with cores-1 threads
     asio::thread_pool cpuPool(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
 
-    // init Redis connection pool
+    // init Redis connection pool (REDIS_HOST/REDIS_PORT/REDIS_CLUSTER override for local clusters)
+    const char* redisHost = std::getenv("REDIS_HOST");
+    const char* redisPort = std::getenv("REDIS_PORT");
+    const char* redisCluster = std::getenv("REDIS_CLUSTER");
+    const char* redisPassword = std::getenv("REDIS_PASSWORD");
     redis::config cfg;
-    cfg.addr.host = "redis-16216.c15.us-east-1-4.ec2.redns.redis-cloud.com";
-    cfg.addr.port = "16216";
+    cfg.addr.host = redisHost ? redisHost : "redis-16216.c15.us-east-1-4.ec2.redns.redis-cloud.com";
+    cfg.addr.port = redisPort ? redisPort : "16216";
     cfg.username = "default";
-    cfg.password = std::getenv("REDIS_PASSWORD");
+    cfg.password = redisPassword ? redisPassword : "";
     cfg.health_check_interval = std::chrono::seconds(10);
-    RedisPool redisPool(exec, cfg, CONFIG::REDIS_CONNECTIONS / 2);
-    redis::logger lg(boost::redis::logger::level::emerg);
-    redis::connection redisConn(exec, lg); // separate connection for BRPOP
-    redisConn.async_run(cfg, asio::detached);  
+    const bool cluster = redisCluster && std::string(redisCluster) == "1";
+    RedisPool redisPool(exec, cfg, CONFIG::REDIS_CONNECTIONS / 2, cluster);
+    if (cluster)
+        co_await redisPool.refreshSlots();
 
     AsyncSemaphore pipelineSem(exec, CONFIG::PIPELINE_LIMIT);
     std::unordered_set<std::string> inPipeline;
 
     DelayedUpdates delayedUpdates;
 
+    PurgeEngine purgeEngine(exec, cfCli, VARS::CF_CHUNKS_BUCKET_URL);
+    asio::co_spawn(exec, purgeEngine.run(), asio::detached);
+
+    // flushed write-back chunks still need their cdn copy purged
+    if (CONFIG::R2_WRITE_BACK) {
+        cfCli->setFlushHook([&purgeEngine](const std::string& bucket, const std::string& key) {
+            if (bucket == VARS::CF_CHUNKS_BUCKET)
+                purgeEngine.push(key);
+        });
+        asio::co_spawn(exec, cfCli->writeBackLoop(), asio::detached);
+    }
+
+    asio::co_spawn(exec, statsLoop(redisPool, purgeEngine), asio::detached);
+
+    // open connections to R2 before the first jobs arrive and keep them warm while quiet
+    asio::co_spawn(exec, cfCli->keepWarm(VARS::CF_CHUNKS_BUCKET, killFlag), asio::detached);
+
     std::cout << "Started" << std::endl;
 
     for (;;) {
@@ -260,28 +304,31 @@ asio::awaitable<void> mainLoop() {
                 co_await timer.async_wait(asio::use_awaitable);
             }
             
-            // empty purge queue
-            while (needsPurge.size() > 0) {
-                co_await purgeChunks();
-                timer.expires_after(std::chrono::milliseconds(VARS::PURGE_DELAY));
-                co_await timer.async_wait(asio::use_awaitable);
+            // flush dirty write-back objects, this also queues their purges
+            if (CONFIG::R2_WRITE_BACK) {
+                std::cout << "Flushing " << cfCli->writeBackStats().dirty << " write-back objects..." << std::endl;
+                co_await cfCli->flushWriteBack();
             }
 
+            // empty purge queue
+            std::cout << "Draining " << purgeEngine.stats().queued << " purges..." << std::endl;
+            co_await purgeEngine.drain();
+
             // push all delayed updates to queue
             std::cout << "Queuing delayed updates..." << std::endl;
-            co_await delayedUpdates.purge(redisConn);
+            co_await delayedUpdates.purge(redisPool);
             break;
         }
 
         // listen for chunks to be pushed to update queue
         std::string chunkId;
         try {
-            co_await delayedUpdates.refresh(redisConn);
+            co_await delayedUpdates.refresh(redisPool);
 
             redis::request req;
             redis::response<std::optional<std::array<std::string, 2>>> resp;
             req.push("BRPOP", VARS::REDIS_UPDATE_QUEUE_PREFIX, "5");
-            co_await redisConn.async_exec(req, resp, asio::use_awaitable);
+            co_await redisPool.execBlocking(VARS::REDIS_UPDATE_QUEUE_PREFIX, req, resp);
 
             const auto& result = std::get<0>(resp).value();
             if (!result.has_value())
@@ -302,9 +349,10 @@ asio::awaitable<void> mainLoop() {
             // requeue chunk id
             try {
                 redis::request req;
-                redis::response<redis::ignore_t> resp;
+                redis::response<int64_t> resp;
                 req.push("LPUSH", VARS::REDIS_UPDATE_QUEUE_PREFIX, chunkId);
-                co_await redisConn.async_exec(req, resp, asio::use_awaitable);
+                co_await redisPool.exec(VARS::REDIS_UPDATE_QUEUE_PREFIX, req, resp);
+                std::get<0>(resp).value();
             } catch(const std::exception& e) { 
                 std::cerr << "[ex] " << e.what() << "\n";
             }
@@ -319,6 +367,7 @@ asio::awaitable<void> mainLoop() {
             redisPool,
             cpuPool, 
             delayedUpdates,
+            purgeEngine,
             pipelineSem,
             inPipeline,
             std::move(chunkId)
@@ -332,6 +381,33 @@ asio::awaitable<void> mainLoop() {
     co_return;
 }
 
+// R2_BACKEND selects the object store: sdk, native, or local (a directory, see
+// LocalObjectStore) for benchmarking without network. R2_ENDPOINT overrides the R2 account
+static std::unique_ptr<ObjectStore> makeObjectStore() {
+    const auto env = [](const char* name, const std::string& fallback) {
+        const char* value = std::getenv(name);
+        return value ? std::string(value) : fallback;
+    };
+    const std::string backend = env("R2_BACKEND", CONFIG::R2_NATIVE_CLIENT ? "native" : "sdk");
+
+    if (backend == "local") {
+        const std::string dir = env("LOCAL_STORE_DIR", CONFIG::LOCAL_STORE_DIR);
+        const int64_t latencyMs = std::stoll(env("LOCAL_STORE_LATENCY_MS", std::to_string(CONFIG::LOCAL_STORE_LATENCY_MS)));
+        const double bandwidth = std::stod(env("LOCAL_STORE_BANDWIDTH_MBPS", std::to_string(CONFIG::LOCAL_STORE_BANDWIDTH_MBPS)));
+        std::cout << fmt::format("Using local object store at {} ({} ms, {} MB/s)", dir, latencyMs, bandwidth) << std::endl;
+        return std::make_unique<LocalObjectStore>(dir, latencyMs, bandwidth);
+    }
+
+    const std::string endPoint = env("R2_ENDPOINT", VARS::R2_ENDPOINT);
+    const std::string accessKey = env("CF_R2_ACCESS_KEY", "");
+    const std::string secretKey = env("CF_R2_SECRET_KEY", "");
+    if (backend == "native")
+        return std::make_unique<S3NativeObjectStore>(endPoint, accessKey, secretKey, CONFIG::R2_NATIVE_MAX_IDLE);
+    if (backend != "sdk")
+        throw std::invalid_argument("Unknown R2_BACKEND " + backend);
+    return std::make_unique<S3SdkObjectStore>(endPoint, accessKey, secretKey, CONFIG::R2_CONNECTIONS);
+}
+
 int main() {
     char* envc = std::getenv("ENV");
     std::string env = envc ? envc : "";
@@ -340,14 +416,21 @@ int main() {
 
     Aws::SDKOptions s3Opts;
     Aws::InitAPI(s3Opts);
+    const char* backend = std::getenv("R2_BACKEND");
+    const bool local = backend && std::string(backend) == "local";
+    // CF_API_ENDPOINT points purges at a local mock (scripts/mock_purge.py) when testing,
+    // a local store skips purges unless it is set
+    const char* cfApiEndPoint = std::getenv("CF_API_ENDPOINT");
     cfCli = std::make_shared<CFAsyncClient>(
-        "https://1534f5e1cce37d41a018df4c9716751e.r2.cloudflarestorage.com",
-        std::getenv("CF_R2_ACCESS_KEY"),
-        std::getenv("CF_R2_SECRET_KEY"),
-        std::getenv("CF_API_TOKEN"),
+        makeObjectStore(),
+        std::getenv("CF_API_TOKEN") ? std::getenv("CF_API_TOKEN") : "",
         CONFIG::R2_CONNECTIONS,
         true, // enable cache
-        CONFIG::R2_CACHE_SIZE * (1<<5)
+        std::unordered_map<std::string, size_t>{
+            {VARS::CF_CHUNKS_BUCKET, CONFIG::R2_CACHE_CHUNKS_SIZE << 20},
+            {VARS::CF_POINT_CLOUDS_BUCKET, CONFIG::R2_CACHE_POINT_CLOUDS_SIZE << 20}
+        },
+        cfApiEndPoint ? cfApiEndPoint : local ? "" : "https://api.cloudflare.com"
     );
 
     assert(CONFIG::PIPELINE_LIMIT > 1 && "Pipeline limit must be greater than 1");
@@ -365,7 +448,6 @@ int main() {
     });
     
     // create coroutine for main loop
-    asio::co_spawn(ioc, purgeLoop(), asio::detached);
     asio::co_spawn(ioc, mainLoop(), asio::detached);
     ioc.run();
 
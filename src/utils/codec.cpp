@@ -0,0 +1,161 @@
+#include <fstream>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <iostream>
+
+#include <zstd.h>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <fmt/format.h>
+
+#include "utils/codec.hpp"
+#include "config/config.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    struct Dictionaries {
+        std::unordered_map<std::string, ZSTD_CDict*> byName;
+        std::unordered_map<unsigned, ZSTD_DDict*> byId;
+
+        Dictionaries() {
+            std::error_code ec;
+            for (const auto& entry : fs::directory_iterator(CONFIG::ZSTD_DICT_DIR, ec)) {
+                if (entry.path().extension() != ".dict")
+                    continue;
+                std::ifstream file(entry.path(), std::ios::binary);
+                const std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                const unsigned id = ZSTD_getDictID_fromDict(data.data(), data.size());
+                if (id == 0) {
+                    std::cerr << "[codec] " << entry.path() << " is not a zstd dictionary" << std::endl;
+                    continue;
+                }
+                byName[entry.path().stem().string()] = ZSTD_createCDict(data.data(), data.size(), CONFIG::ZSTD_LEVEL);
+                byId[id] = ZSTD_createDDict(data.data(), data.size());
+            }
+        }
+
+        ~Dictionaries() {
+            for (const auto& [_, d] : byName)
+                ZSTD_freeCDict(d);
+            for (const auto& [_, d] : byId)
+                ZSTD_freeDDict(d);
+        }
+    };
+
+    // loaded once, read only afterwards
+    const Dictionaries& dictionaries() {
+        static const Dictionaries dicts;
+        return dicts;
+    }
+
+    // contexts are reused per thread
+    ZSTD_CCtx* cctx() {
+        thread_local std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> ctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+        return ctx.get();
+    }
+
+    ZSTD_DCtx* dctx() {
+        thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> ctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        return ctx.get();
+    }
+
+}
+
+std::vector<uint8_t> Codec::encode(std::vector<uint8_t>&& buf, Type type, const std::string& dict, uint8_t layout) {
+    if (buf.size() < HEADER_SIZE)
+        throw std::runtime_error("Object is smaller than its header");
+    if (layout > 0xF)
+        throw std::runtime_error(fmt::format("Layout {} doesn't fit the header", layout));
+    buf[0] = VERSION_RAW;
+    buf[1] = codecByte(Type::None, layout);
+    if (type == Type::None)
+        return std::move(buf);
+
+    const uint8_t* src = buf.data() + HEADER_SIZE;
+    const size_t srcSize = buf.size() - HEADER_SIZE;
+    std::vector<uint8_t> out(HEADER_SIZE + ZSTD_compressBound(srcSize));
+
+    const auto& dicts = dictionaries().byName;
+    const auto it = dict.empty() ? dicts.end() : dicts.find(dict);
+    const size_t n = it != dicts.end()
+        ? ZSTD_compress_usingCDict(cctx(), out.data() + HEADER_SIZE, out.size() - HEADER_SIZE, src, srcSize, it->second)
+        : ZSTD_compressCCtx(cctx(), out.data() + HEADER_SIZE, out.size() - HEADER_SIZE, src, srcSize, CONFIG::ZSTD_LEVEL);
+    if (ZSTD_isError(n))
+        throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(n));
+
+    // not worth it, keep the raw layout
+    if (n >= srcSize)
+        return std::move(buf);
+
+    out.resize(HEADER_SIZE + n);
+    out[0] = VERSION_COMPRESSED;
+    out[1] = codecByte(type, layout);
+    return out;
+}
+
+Codec::Decoded Codec::decode(std::span<const uint8_t> body) {
+    if (body.size() < HEADER_SIZE)
+        throw std::runtime_error("Object is smaller than its header");
+
+    Decoded out;
+    out.layout = layoutOf(body);
+    if (body[0] == VERSION_RAW) {
+        out.payload = body.subspan(HEADER_SIZE);
+        return out;
+    }
+    if (body[0] != VERSION_COMPRESSED)
+        throw std::runtime_error(fmt::format("Unknown object version {}", body[0]));
+    if ((body[1] & 0xF) != static_cast<uint8_t>(Type::Zstd))
+        throw std::runtime_error(fmt::format("Unknown object codec {}", body[1] & 0xF));
+
+    const auto src = body.subspan(HEADER_SIZE);
+    const unsigned long long size = ZSTD_getFrameContentSize(src.data(), src.size());
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR)
+        throw std::runtime_error("Corrupt zstd frame");
+    // the size comes from the frame header, don't trust it with the allocation
+    if (size > CONFIG::ZSTD_MAX_DECODED_SIZE << 20)
+        throw std::runtime_error(fmt::format("zstd frame of {} bytes is above the decode limit", size));
+    out.owned.resize(size);
+
+    size_t n;
+    if (const unsigned id = ZSTD_getDictID_fromFrame(src.data(), src.size()); id != 0) {
+        const auto& dicts = dictionaries().byId;
+        const auto it = dicts.find(id);
+        if (it == dicts.end())
+            throw std::runtime_error(fmt::format("Missing zstd dictionary {}", id));
+        n = ZSTD_decompress_usingDDict(dctx(), out.owned.data(), out.owned.size(), src.data(), src.size(), it->second);
+    } else
+        n = ZSTD_decompressDCtx(dctx(), out.owned.data(), out.owned.size(), src.data(), src.size());
+    if (ZSTD_isError(n) || n != size)
+        throw std::runtime_error(std::string("zstd decompression failed: ") + (ZSTD_isError(n) ? ZSTD_getErrorName(n) : "size mismatch"));
+
+    out.payload = out.owned;
+    return out;
+}
+
+asio::awaitable<std::vector<uint8_t>> Codec::encodeOn(
+    asio::any_io_executor exec,
+    std::vector<uint8_t>&& buf,
+    Type type,
+    const std::string& dict,
+    uint8_t layout
+) {
+    auto task = [buf = std::move(buf), type, dict, layout]() mutable -> asio::awaitable<std::vector<uint8_t>> {
+        co_return encode(std::move(buf), type, dict, layout);
+    };
+    co_return co_await asio::co_spawn(exec, std::move(task), asio::use_awaitable);
+}
+
+asio::awaitable<Codec::Decoded> Codec::decodeOn(asio::any_io_executor exec, std::span<const uint8_t> body) {
+    // raw objects need no work
+    if (!body.empty() && body[0] == VERSION_RAW)
+        co_return decode(body);
+    auto task = [body]() -> asio::awaitable<Decoded> {
+        co_return decode(body);
+    };
+    co_return co_await asio::co_spawn(exec, std::move(task), asio::use_awaitable);
+}
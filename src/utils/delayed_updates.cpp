@@ -2,6 +2,7 @@
 #include <iostream>
 
 #include "utils/delayed_updates.hpp"
+#include "utils/redis_keys.hpp"
 
 void DelayedUpdates::track(
     const std::string& chunkId, 
@@ -22,7 +23,7 @@ void DelayedUpdates::track(
     _queuedItems[chunkId].insert(childId);
 }
 
-asio::awaitable<void> DelayedUpdates::refresh(redis::connection& redisConn) {
+asio::awaitable<void> DelayedUpdates::refresh(RedisPool& redisPool) {
     const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::steady_clock::now().time_since_epoch()
     ).count();
@@ -30,45 +31,47 @@ asio::awaitable<void> DelayedUpdates::refresh(redis::connection& redisConn) {
     // while now > queue item time stamp
     while (!_queue.empty() && _queue.top().first <= now) {
         const std::string& chunkId = _queue.top().second;
-        co_await queueUpdate(redisConn, chunkId);
+        co_await queueUpdate(redisPool, chunkId);
         _queuedItems.erase(chunkId);
         _queue.pop();
     }
     co_return;
 }
 
-asio::awaitable<void> DelayedUpdates::purge(redis::connection& redisConn) {
+asio::awaitable<void> DelayedUpdates::purge(RedisPool& redisPool) {
     for (const auto& [chunkId, _] : _queuedItems)  {
-        co_await queueUpdate(redisConn, chunkId);
+        co_await queueUpdate(redisPool, chunkId);
     }
     co_return;
 }
 
 asio::awaitable<void> DelayedUpdates::queueUpdate(
-    redis::connection& redisConn, 
+    RedisPool& redisPool, 
     const std::string& chunkId
 ) {
+    // the needs update set and the queue live in different slots, so the set is updated
+    // on its own and the script reports whether the chunk still has to be queued
     static const std::string script = R"(
         local existed = redis.call('EXISTS', KEYS[1])
-        local added = redis.call('SADD', KEYS[1], unpack(ARGV, 3, #ARGV))
+        local added = redis.call('SADD', KEYS[1], unpack(ARGV, 2, #ARGV))
     
         if existed == 0 and added > 0 then
             redis.call('EXPIRE', KEYS[1], ARGV[1])
-            redis.call('LPUSH', KEYS[2], ARGV[2])
+            return 1
         end
 
         return 0
     )";
 
+    const std::string setKey = RedisKeys::needsUpdate(chunkId);
+
     std::vector<std::string> args;
     args.push_back(script);
-    args.push_back("2");
-    args.push_back(VARS::REDIS_UPDATE_NEEDS_UPDATE_PREFIX + chunkId); 
-    args.push_back(VARS::REDIS_UPDATE_QUEUE_PREFIX);
+    args.push_back("1");
+    args.push_back(setKey);
 
     // Fixed args first
     args.push_back(VARS::REDIS_EXPIRE);  // ARGV[1]
-    args.push_back(chunkId);              // ARGV[2]
 
     // Variable list last
     auto iter = _queuedItems[chunkId].begin();
@@ -78,11 +81,28 @@ asio::awaitable<void> DelayedUpdates::queueUpdate(
         ++iter;
     }
 
-    redis::request req;
-    redis::response<redis::ignore_t> res;
-    req.push_range("EVAL", args);   
+    bool created;
+    {
+        redis::request req;
+        redis::response<int64_t> res;
+        req.push_range("EVAL", args);   
+
+        co_await redisPool.exec(setKey, req, res);
+        created = std::get<0>(res).value() == 1;
+    }
 
-    co_await redisConn.async_exec(req, res, asio::use_awaitable);
+    // once the set exists the script won't report it again, so a failed push is remembered
+    // and retried on the next call for this chunk (the caller keeps it queued on errors)
+    if (created)
+        _unpushed.insert(chunkId);
+    if (_unpushed.contains(chunkId)) {
+        redis::request req;
+        redis::response<int64_t> res;
+        req.push("LPUSH", VARS::REDIS_UPDATE_QUEUE_PREFIX, chunkId);
+        co_await redisPool.exec(VARS::REDIS_UPDATE_QUEUE_PREFIX, req, res);
+        std::get<0>(res).value();
+        _unpushed.erase(chunkId);
+    }
 
     co_return;
 }
\ No newline at end of file
@@ -5,11 +5,63 @@
 #include <stdexcept>
 #include <iterator>    
 #include <iostream>
+#include <cstring>
+#include <string>
 
 #include <nlohmann/json.hpp>
 
 #include "utils/plot.hpp"
+#include "config/config.hpp"
+
+Plot::UpdateFlags Plot::parseUpdateFlags(std::uint32_t mask) {
+    return UpdateFlags{
+        (mask & VARS::REDIS_FLAG_METADATA_ONLY) != 0,
+        (mask & VARS::REDIS_FLAG_SET_DEFAULT_JSON) != 0,
+        (mask & VARS::REDIS_FLAG_SET_DEFAULT_BUILD) != 0,
+        (mask & VARS::REDIS_FLAG_NO_IMAGE_UPDATE) != 0
+    };
+}
+
+bool Plot::hasMetaHeader(std::span<const std::uint8_t> plotData) {
+    if (plotData.size() < META_HEADER_SIZE)
+        return false;
+    std::uint32_t magic;
+    std::memcpy(&magic, plotData.data(), sizeof(std::uint32_t));
+    return magic == META_MAGIC;
+}
+
+bool Plot::fitsMetaHeader(const Meta& meta) {
+    return meta.owner.size() <= OWNER_SIZE;
+}
 
+Plot::Meta Plot::getMeta(std::span<const std::uint8_t> plotData) {
+    if (!hasMetaHeader(plotData))
+        throw std::runtime_error("Plot part has no metadata header");
+    const std::uint8_t* p = plotData.data() + sizeof(std::uint32_t);
+    const size_t ownerLen = p[1];
+    if (ownerLen > OWNER_SIZE)
+        throw std::runtime_error("Plot metadata header is malformed");
+    return Meta{
+        (p[0] & META_FLAG_VERIFIED) != 0,
+        std::string(reinterpret_cast<const char*>(p + 2), ownerLen)
+    };
+}
+
+void Plot::setMeta(std::span<std::uint8_t> plotData, const Meta& meta) {
+    if (!hasMetaHeader(plotData))
+        throw std::runtime_error("Plot part has no metadata header");
+    if (!fitsMetaHeader(meta))
+        throw std::runtime_error("Plot owner doesn't fit the metadata header");
+    std::uint8_t* p = plotData.data() + sizeof(std::uint32_t);
+    p[0] = meta.verified ? META_FLAG_VERIFIED : 0;
+    p[1] = static_cast<std::uint8_t>(meta.owner.size());
+    std::memset(p + 2, 0, OWNER_SIZE);
+    std::memcpy(p + 2, meta.owner.data(), meta.owner.size());
+}
+
+std::span<const std::uint8_t> Plot::stripMetaHeader(std::span<const std::uint8_t> plotData) {
+    return hasMetaHeader(plotData) ? plotData.subspan(META_HEADER_SIZE) : plotData;
+}
 
 nlohmann::json Plot::getDefaultJsonPart() {
     nlohmann::json j;
@@ -40,7 +92,8 @@ std::span<const uint8_t> Plot::getDefaultBuildData() {
     return { defaultBuild.data(), defaultBuild.size() };
 }
 
-std::span<const uint8_t> Plot::getBuildData(const std::vector<uint8_t>& plotData) {
+std::span<const uint8_t> Plot::getBuildData(std::span<const uint8_t> plotData) {
+    plotData = stripMetaHeader(plotData);
     uint32_t jsonLen;
     std::memcpy(&jsonLen, plotData.data(), sizeof(uint32_t));
     const size_t offset = static_cast<size_t>(jsonLen) + 8;
@@ -48,17 +101,34 @@ std::span<const uint8_t> Plot::getBuildData(const std::vector<uint8_t>& plotData
     return { plotData.data() + offset, plotData.size() - offset };
 }
 
-nlohmann::json Plot::getJsonPart(const std::vector<uint8_t>& plotData) {
+std::span<const uint8_t> Plot::getJsonData(std::span<const uint8_t> plotData) {
+    plotData = stripMetaHeader(plotData);
     uint32_t jsonLen;
     std::memcpy(&jsonLen, plotData.data(), sizeof(uint32_t));
 
-    const char* begin = reinterpret_cast<const char*>(&plotData[4]);
-    const char* end = begin + jsonLen;
+    return { plotData.data() + 4, jsonLen };
+}
 
-    return nlohmann::json::parse(begin, end, nullptr, true, false);
+nlohmann::json Plot::getJsonPart(std::span<const uint8_t> plotData) {
+    const auto jsonData = getJsonData(plotData);
+    const char* begin = reinterpret_cast<const char*>(jsonData.data());
+    const char* end = begin + jsonData.size();
+
+    auto json = nlohmann::json::parse(begin, end, nullptr, true, false);
+    if (hasMetaHeader(plotData)) {
+        const auto meta = getMeta(plotData);
+        json["verified"] = meta.verified;
+        json["owner"] = meta.owner;
+        if (!meta.verified) {
+            json["link"] = "";
+            json["linkTitle"] = "";
+        }
+    }
+    return json;
 }
 
-std::vector<std::uint16_t> Plot::getBuildPart(const std::vector<std::uint8_t>& plotData) {
+std::vector<std::uint16_t> Plot::getBuildPart(std::span<const std::uint8_t> plotData) {
+    plotData = stripMetaHeader(plotData);
     std::uint32_t jsonLen;
     std::uint32_t buildLen;
 
@@ -72,7 +142,8 @@ std::vector<std::uint16_t> Plot::getBuildPart(const std::vector<std::uint8_t>& p
     return buildData;
 }
 
-std::uint16_t Plot::getBuildSize(const std::vector<std::uint8_t>& plotData) {
+std::uint16_t Plot::getBuildSize(std::span<const std::uint8_t> plotData) {
+    plotData = stripMetaHeader(plotData);
     std::uint32_t jsonLen;
     std::uint16_t buildSize;
 
@@ -100,3 +171,27 @@ std::vector<std::uint8_t> Plot::makePlotData(const nlohmann::json& json, const s
   
     return plotData;
 }
+
+std::vector<std::uint8_t> Plot::makePlotPart(const Meta& meta, std::span<const std::uint8_t> jsonData, std::span<const std::uint8_t> buildData) {
+    const std::uint32_t jsonLen = jsonData.size();
+    const std::uint32_t buildLen = buildData.size();
+    std::vector<std::uint8_t> plotData(META_HEADER_SIZE + jsonLen + buildLen + 8);
+    std::memcpy(plotData.data(), &META_MAGIC, sizeof(std::uint32_t));
+    setMeta(plotData, meta);
+
+    // the rest as makePlotData lays it out
+    std::uint8_t* p = plotData.data() + META_HEADER_SIZE;
+    std::memcpy(p, &jsonLen, sizeof(std::uint32_t));
+    std::memcpy(p + 4, jsonData.data(), jsonLen);
+    std::memcpy(p + jsonLen + 4, &buildLen, sizeof(std::uint32_t));
+    std::memcpy(p + jsonLen + 8, buildData.data(), buildLen);
+
+    return plotData;
+}
+
+std::vector<std::uint8_t> Plot::makeMetaHeader(const Meta& meta) {
+    std::vector<std::uint8_t> header(META_HEADER_SIZE);
+    std::memcpy(header.data(), &META_MAGIC, sizeof(std::uint32_t));
+    setMeta(header, meta);
+    return header;
+}
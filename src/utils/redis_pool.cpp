@@ -1,24 +1,277 @@
 #include "utils/redis_pool.hpp"
+#include "config/config.hpp"
+
+#include <array>
+#include <charconv>
+#include <iostream>
 
 #include <boost/asio.hpp>
 #include <boost/redis/connection.hpp>
 
-// #include 
-RedisPool::RedisPool(const asio::any_io_executor& exec, const redis::config& cfg, size_t poolSize) {
+RedisPool::RedisPool(
+    const asio::any_io_executor& exec, 
+    const redis::config& cfg, 
+    size_t poolSize, 
+    bool cluster
+) : _exec(exec), _cfg(cfg), _poolSize(poolSize), _cluster(cluster), _slots(SLOT_COUNT, 0) {
+    // seed node, every slot maps here until the cluster slot map is loaded
+    nodeAt(cfg.addr.host, cfg.addr.port);
+}
+
+uint16_t RedisPool::keySlot(std::string_view key) {
+    // crc16 (xmodem) as used by redis cluster
+    static constexpr auto table = []() {
+        std::array<uint16_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint16_t crc = i << 8;
+            for (int j = 0; j < 8; ++j)
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            t[i] = crc;
+        }
+        return t;
+    }();
+
+    // only hash the {tag} if one is present and non-empty
+    const size_t open = key.find('{');
+    if (open != std::string_view::npos) {
+        const size_t close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close > open + 1)
+            key = key.substr(open + 1, close - open - 1);
+    }
+
+    uint16_t crc = 0;
+    for (const unsigned char c : key)
+        crc = (crc << 8) ^ table[((crc >> 8) ^ c) & 0xFF];
+    return crc & (SLOT_COUNT - 1);
+}
+
+RedisPool::Node& RedisPool::nodeFor(std::string_view key) {
+    if (!_cluster)
+        return *_nodes[0];
+    return *_nodes[_slots[keySlot(key)]];
+}
+
+RedisPool::Node& RedisPool::nodeAt(const std::string& host, const std::string& port) {
+    for (auto& node : _nodes)
+        if (node->host == host && node->port == port)
+            return *node;
+
+    auto cfg = _cfg;
+    cfg.addr.host = host;
+    cfg.addr.port = port;
     redis::logger lg(boost::redis::logger::level::emerg);
-    
-    for (size_t i = 0; i < poolSize; ++i) {
-        auto conn = std::make_unique<redis::connection>(exec, lg);
-        conn->async_run(cfg, asio::detached);
-        _connections.push_back(std::move(conn));
+
+    auto node = std::make_unique<Node>();
+    node->host = host;
+    node->port = port;
+    node->conns.resize(_poolSize);
+    for (auto& c : node->conns) {
+        c.conn = std::make_unique<redis::connection>(_exec, lg);
+        c.conn->async_run(cfg, asio::detached);
+        asio::co_spawn(_exec, watch(c), asio::detached);
+    }
+
+    _nodes.push_back(std::move(node));
+    return *_nodes.back();
+}
+
+size_t RedisPool::pick(Node& node) {
+    const auto now = std::chrono::steady_clock::now();
+    auto& conns = node.conns;
+
+    // least outstanding requests wins, ties go to the lower latency connection.
+    // unhealthy connections are only used once their cooldown expires or if nothing else is left
+    size_t best = 0, fallback = 0;
+    bool found = false;
+    for (size_t i = 0; i < conns.size(); ++i) {
+        auto& c = conns[i];
+        if (!c.healthy && now >= c.unhealthyUntil)
+            c.healthy = true; // allow a probe request through
+
+        const auto& f = conns[fallback];
+        if (c.outstanding < f.outstanding || (c.outstanding == f.outstanding && c.latencyMs < f.latencyMs))
+            fallback = i;
+
+        if (!c.healthy)
+            continue;
+
+        const auto& b = conns[best];
+        if (!found || c.outstanding < b.outstanding || (c.outstanding == b.outstanding && c.latencyMs < b.latencyMs)) {
+            best = i;
+            found = true;
+        }
+    }
+
+    return found ? best : fallback;
+}
+
+void RedisPool::complete(Conn& c, std::chrono::steady_clock::time_point start, bool ok, bool connectionError) {
+    --c.outstanding;
+    ++c.requests;
+
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    c.latencyMs = c.requests == 1 ? ms : c.latencyMs + CONFIG::REDIS_LATENCY_EWMA_ALPHA * (ms - c.latencyMs);
+
+    if (!ok)
+        ++c.errors;
+    if (connectionError)
+        markUnhealthy(c);
+}
+
+void RedisPool::markUnhealthy(Conn& c) {
+    c.healthy = false;
+    c.unhealthyUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds(CONFIG::REDIS_UNHEALTHY_COOLDOWN_MS);
+}
+
+bool RedisPool::isConnectionError(const boost::system::error_code& ec) {
+    // error replies and responses that don't fit their type are in the redis category, of
+    // which only the connection errors count. everything else comes from the socket, the
+    // resolver or tls, or is a request cancelled because its connection was lost
+    if (ec.category() != redis::make_error_code(redis::error::not_connected).category())
+        return true;
+    return ec == redis::error::not_connected
+        || ec == redis::error::resolve_timeout
+        || ec == redis::error::connect_timeout
+        || ec == redis::error::pong_timeout
+        || ec == redis::error::ssl_handshake_timeout;
+}
+
+asio::awaitable<void> RedisPool::watch(Conn& c) {
+    // requests wait for a reconnecting connection by default, the probe fails right away so
+    // the connection is skipped until its runner is connected again
+    redis::request req;
+    req.get_config().cancel_if_not_connected = true;
+    req.push("PING");
+
+    asio::steady_timer timer(_exec);
+    for (;;) {
+        timer.expires_after(std::chrono::milliseconds(CONFIG::REDIS_HEALTH_CHECK_MS));
+        co_await timer.async_wait(asio::use_awaitable);
+
+        boost::system::error_code ec;
+        co_await c.conn->async_exec(req, redis::ignore, asio::redirect_error(asio::use_awaitable, ec));
+        if (ec && isConnectionError(ec))
+            markUnhealthy(c);
+        else if (!ec)
+            c.healthy = true;
     }
 }
 
-redis::connection& RedisPool::get() {
-    size_t idx = _next++ % _connections.size();
-    return *_connections[idx];
+std::optional<RedisPool::Redirect> RedisPool::parseRedirect(std::string_view diagnostic) {
+    // "MOVED <slot> <host>:<port>" or "ASK <slot> <host>:<port>"
+    Redirect r;
+    if (diagnostic.starts_with("MOVED "))
+        r.ask = false;
+    else if (diagnostic.starts_with("ASK "))
+        r.ask = true;
+    else
+        return std::nullopt;
+
+    const size_t slotBegin = diagnostic.find(' ') + 1;
+    const size_t slotEnd = diagnostic.find(' ', slotBegin);
+    if (slotEnd == std::string_view::npos)
+        return std::nullopt;
+    
+    const auto [ptr, ec] = std::from_chars(diagnostic.data() + slotBegin, diagnostic.data() + slotEnd, r.slot);
+    if (ec != std::errc{} || r.slot >= SLOT_COUNT)
+        return std::nullopt;
+
+    const auto addr = diagnostic.substr(slotEnd + 1);
+    const size_t colon = addr.rfind(':');
+    if (colon == std::string_view::npos)
+        return std::nullopt;
+
+    r.host = addr.substr(0, colon);
+    r.port = addr.substr(colon + 1);
+    return r;
 }
 
-redis::connection& RedisPool::operator[](size_t idx) {
-    return *_connections[idx % _connections.size()];
-}
\ No newline at end of file
+void RedisPool::follow(const Redirect& redirect, Node*& node) {
+    // an empty endpoint means the node we just talked to
+    if (!redirect.host.empty())
+        node = &nodeAt(redirect.host, redirect.port);
+    if (redirect.ask)
+        return;
+
+    // MOVED is permanent, patch the slot and reload the whole map in the background
+    for (size_t i = 0; i < _nodes.size(); ++i)
+        if (_nodes[i].get() == node)
+            _slots[redirect.slot] = i;
+
+    if (!_refreshing)
+        asio::co_spawn(_exec, refreshSlots(), asio::detached);
+}
+
+const redis::request& RedisPool::askingRequest() {
+    static const redis::request req = []() {
+        redis::request r;
+        r.push("ASKING");
+        return r;
+    }();
+    return req;
+}
+
+asio::awaitable<void> RedisPool::refreshSlots() {
+    if (!_cluster || _refreshing)
+        co_return;
+    _refreshing = true;
+
+    try {
+        redis::request req;
+        req.push("CLUSTER", "SLOTS");
+        redis::generic_response res;
+
+        auto& seed = *_nodes[0];
+        co_await seed.conns[pick(seed)].conn->async_exec(req, res, asio::use_awaitable);
+        const auto& nodes = res.value();
+
+        // [[start, end, [host, port, id, ...], replicas...], ...]
+        // walk the flattened resp3 tree, only the first nested array of each range is the master
+        uint16_t start = 0, end = 0;
+        size_t d2 = 0, d3 = 0;
+        std::string host;
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            const auto& n = nodes[i];
+            if (n.depth == 1) {
+                d2 = 0;
+                continue;
+            }
+            if (n.depth == 2) {
+                if (d2 == 0)
+                    std::from_chars(n.value.data(), n.value.data() + n.value.size(), start);
+                else if (d2 == 1)
+                    std::from_chars(n.value.data(), n.value.data() + n.value.size(), end);
+                ++d2;
+                d3 = 0;
+                continue;
+            }
+            if (n.depth != 3 || d2 != 3)
+                continue;
+
+            if (d3 == 0)
+                host = n.value.empty() || n.value == "?" ? seed.host : std::string(n.value);
+            else if (d3 == 1) {
+                Node& owner = nodeAt(host, std::string(n.value));
+                size_t idx = 0;
+                while (_nodes[idx].get() != &owner)
+                    ++idx;
+                for (size_t s = start; s <= end && s < SLOT_COUNT; ++s)
+                    _slots[s] = idx;
+            }
+            ++d3;
+        }
+        std::cout << "[redis] loaded cluster slot map, " << _nodes.size() << " nodes" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "[ex] " << e.what() << "\n";
+    }
+
+    _refreshing = false;
+}
+
+std::vector<RedisPool::ConnStats> RedisPool::stats() const {
+    std::vector<ConnStats> out;
+    for (const auto& node : _nodes)
+        for (const auto& c : node->conns)
+            out.push_back({node->host + ":" + node->port, c.outstanding, c.healthy, c.latencyMs, c.requests, c.errors});
+    return out;
+}
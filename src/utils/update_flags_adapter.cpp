@@ -0,0 +1,24 @@
+#include <cstdint>
+#include <charconv>
+
+#include <boost/redis/error.hpp>
+
+#include "utils/update_flags_adapter.hpp"
+#include "utils/plot.hpp"
+
+void Plot::boost_redis_from_bulk(
+    UpdateFlags& flags, 
+    const boost::redis::resp3::node_view& node, 
+    boost::system::error_code& ec
+) {
+    // missing fields are returned as 0 by the claim script, anything else must be an integer
+    const auto& sv = node.value;
+    std::uint32_t mask = 0;
+    const auto [ptr, err] = std::from_chars(sv.data(), sv.data() + sv.size(), mask);
+    if (err != std::errc{} || ptr != sv.data() + sv.size()) {
+        ec = boost::redis::error::not_a_number;
+        return;
+    }
+
+    flags = parseUpdateFlags(mask);
+}